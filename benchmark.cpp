@@ -0,0 +1,102 @@
+/*  This is a microbenchmark of ribanRpiInterface hot paths
+    Runs against a memory backed fake /dev/gpiomem so may be run on any Linux host
+    Usage: rpibench [iterations]
+    Copyright riban 2021
+    Author: Brian Walton brian@riban.co.uk
+*/
+
+#include "ribanRpiInterface.h"
+#include "ribanRpiPin.h"
+#if __cpp_impl_coroutine
+#include "ribanRpiEvents.h"
+#include <vector> // Provides std::vector
+#endif
+#include "ribangpi_clib/benchmark.h" // Provides benchmark harness
+#include <cstdlib> // Provides atoi
+
+#define DEFAULT_ITERATIONS  1000000
+#define GPPUPPDN3           60
+#define GPIO_MAGIC          0x6770696f
+#define COROUTINE_WAITERS   256
+#define COROUTINE_WAITERS_STR "256"
+
+#if __cpp_impl_coroutine
+static std::mutex g_mutexReady; // Protects g_vReady
+static std::vector<std::coroutine_handle<>> g_vReady; // Coroutines scheduled by event engine
+
+static ribanRpiTask waitEdge(ribanRpiEvents& events, uint8_t gpi)
+{
+    benchmarkSink = benchmarkSink + co_await events.edge(gpi, GPI_EDGE_BOTH, 1000);
+}
+
+static size_t getReadyCount()
+{
+    std::lock_guard<std::mutex> lock(g_mutexReady);
+    return g_vReady.size();
+}
+#endif
+
+int main(int argc, char* argv[])
+{
+    uint32_t nIterations = argc > 1 ? atoi(argv[1]) : DEFAULT_ITERATIONS;
+    if(!nIterations)
+        nIterations = DEFAULT_ITERATIONS;
+    char sPath[FAKE_GPIMEM_PATH_LEN];
+    volatile uint32_t* pRegs;
+    if(createFakeGpiMem(sPath, &pRegs) < 0)
+    {
+        fprintf(stderr, "Failed to create fake GPI register file\n");
+        return -1;
+    }
+    ribanRpiInterface rpi(RRPI_ENABLE_ALL, sPath);
+    if(!rpi.IsInit())
+    {
+        fprintf(stderr, "Raspberry Pi Interface failed to intialise\n");
+        return -1;
+    }
+
+    printf("ribanRpiInterface benchmark (%u iterations)\n", nIterations);
+    BENCHMARK("GetGpi", nIterations, benchmarkSink = benchmarkSink + rpi.GetGpi(4 + (i & 0x0F)));
+    BENCHMARK("GetGpi (debounce)", nIterations, benchmarkSink = benchmarkSink + rpi.GetGpi(4 + (i & 0x0F), 50));
+    BENCHMARK("SetGpi", nIterations, rpi.SetGpi(4 + (i & 0x0F), i & 1));
+    ribanRpiPin<4, GPI_INPUT> input(rpi);
+    ribanRpiPin<17, GPI_OUTPUT> output(rpi);
+    BENCHMARK("ribanRpiPin::Get", nIterations, benchmarkSink = benchmarkSink + input.Get());
+    BENCHMARK("ribanRpiPin::Set", nIterations, output.Set(i & 1));
+    BENCHMARK("ribanRpiPin::High/Low", nIterations, output.High(); output.Low());
+    BENCHMARK("GetMillis", nIterations, benchmarkSink = benchmarkSink + rpi.GetMillis());
+    BENCHMARK("GetMicros", nIterations, benchmarkSink = benchmarkSink + rpi.GetMicros());
+    BENCHMARK("GetNanos", nIterations, benchmarkSink = benchmarkSink + rpi.GetNanos());
+    BENCHMARK("GetSeconds", nIterations, benchmarkSink = benchmarkSink + rpi.GetSeconds());
+    BENCHMARK("GetModel", nIterations / 1000, benchmarkSink = benchmarkSink + ribanRpiInterface::GetModel().length());
+    BENCHMARK("ConfigureGpi (BCM2711)", nIterations / 1000, benchmarkSink = benchmarkSink + rpi.ConfigureGpi(4 + (i & 0x0F), GPI_INPUT_PULLUP));
+    BENCHMARK("ConfigureGpiMask (BCM2711, 26 GPI)", nIterations / 1000, benchmarkSink = benchmarkSink + rpi.ConfigureGpiMask(0x0FFFFFFC, GPI_INPUT_PULLUP));
+    {
+        pRegs[GPPUPPDN3] = GPIO_MAGIC; // Unimplemented BCM2711 pull register selects legacy GPPUD sequence
+        ribanRpiInterface rpiLegacy(RRPI_ENABLE_ALL, sPath);
+        BENCHMARK("ConfigureGpi (BCM2835)", nIterations / 1000, benchmarkSink = benchmarkSink + rpiLegacy.ConfigureGpi(4 + (i & 0x0F), GPI_INPUT_PULLUP));
+        BENCHMARK("ConfigureGpiMask (BCM2835, 26 GPI)", nIterations / 1000, benchmarkSink = benchmarkSink + rpiLegacy.ConfigureGpiMask(0x0FFFFFFC, GPI_INPUT_PULLUP));
+        pRegs[GPPUPPDN3] = 0;
+    }
+#if __cpp_impl_coroutine
+    {
+        // Each iteration suspends COROUTINE_WAITERS coroutines, toggles their pins and resumes them from the scheduler queue
+        ribanRpiEvents events(rpi, [](std::coroutine_handle<> h) {
+            std::lock_guard<std::mutex> lock(g_mutexReady);
+            g_vReady.push_back(h);
+        }, 100);
+        g_vReady.reserve(COROUTINE_WAITERS);
+        BENCHMARK("ribanRpiEvents::edge (" COROUTINE_WAITERS_STR " waiters)", nIterations / 10000,
+            for(uint32_t j = 0; j < COROUTINE_WAITERS; ++j)
+                waitEdge(events, 4 + (j & 0x0F));
+            pRegs[13] = pRegs[13] ^ 0x000FFFF0;
+            while(getReadyCount() < COROUTINE_WAITERS)
+                usleep(10);
+            for(auto h : g_vReady)
+                h.resume();
+            g_vReady.clear();
+        );
+    }
+#endif
+    return 0;
+}
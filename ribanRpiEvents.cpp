@@ -0,0 +1,136 @@
+#include "ribanRpiEvents.h"
+#include "ribangpi_clib/timing.h" //provides timestamp sources
+#include <unistd.h> //provides usleep
+
+#define GPLEV0      13
+
+void ribanRpiEdgeAwaiter::await_suspend(std::coroutine_handle<> handle)
+{
+    m_handle = handle;
+    m_pEvents->add(this); // Must be last access to this - coroutine may be resumed before add returns
+}
+
+ribanRpiEvents::ribanRpiEvents(ribanRpiInterface& rpi, Scheduler scheduler, uint32_t nPeriod) :
+    m_rpi(rpi),
+    m_scheduler(scheduler),
+    m_nPeriod(nPeriod ? nPeriod : 1000),
+    m_bRunning(true)
+{
+    volatile uint32_t* pGpiMap = m_rpi.GetGpiMap();
+    m_nLevel = pGpiMap ? pGpiMap[GPLEV0] : 0; // Sample before returning so that edges after construction are detected
+    m_thread = std::thread(&ribanRpiEvents::run, this);
+}
+
+ribanRpiEvents::~ribanRpiEvents()
+{
+    m_bRunning = false;
+    if(m_thread.joinable())
+        m_thread.join();
+    // Schedule pending waits with timeout result so that their coroutines may complete
+    std::unique_lock<std::mutex> lock(m_mutex);
+    ribanRpiEdgeAwaiter* pWaiter = m_pWaiters;
+    m_pWaiters = nullptr;
+    m_nPending = 0;
+    lock.unlock();
+    while(pWaiter)
+    {
+        ribanRpiEdgeAwaiter* pNext = pWaiter->m_pNext;
+        pWaiter->m_nResult = -1;
+        if(m_scheduler)
+            m_scheduler(pWaiter->m_handle);
+        else
+            pWaiter->m_handle.resume();
+        pWaiter = pNext;
+    }
+}
+
+ribanRpiEdgeAwaiter ribanRpiEvents::edge(uint8_t gpi, uint8_t nEdge, uint32_t nTimeout)
+{
+    return ribanRpiEdgeAwaiter(this, gpi < 32 ? 1UL << gpi : 0, nEdge, nTimeout);
+}
+
+ribanRpiEdgeAwaiter ribanRpiEvents::anyOf(std::initializer_list<uint8_t> gpis, uint8_t nEdge, uint32_t nTimeout)
+{
+    uint32_t nMask = 0;
+    for(uint8_t gpi : gpis)
+        if(gpi < 32)
+            nMask |= 1UL << gpi;
+    return ribanRpiEdgeAwaiter(this, nMask, nEdge, nTimeout);
+}
+
+uint32_t ribanRpiEvents::GetPending()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_nPending;
+}
+
+void ribanRpiEvents::add(ribanRpiEdgeAwaiter* pAwaiter)
+{
+    if(pAwaiter->m_nTimeout)
+        pAwaiter->m_nDeadline = getTimeUs() + (uint64_t)pAwaiter->m_nTimeout * 1000;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    pAwaiter->m_pNext = m_pWaiters;
+    m_pWaiters = pAwaiter;
+    ++m_nPending;
+    if(pAwaiter->m_nDeadline && (!m_nNextDeadline || pAwaiter->m_nDeadline < m_nNextDeadline))
+        m_nNextDeadline = pAwaiter->m_nDeadline;
+}
+
+void ribanRpiEvents::run()
+{
+    volatile uint32_t* pGpiMap = m_rpi.GetGpiMap();
+    if(!pGpiMap)
+        return;
+    uint32_t nLast = m_nLevel;
+    while(m_bRunning)
+    {
+        usleep(m_nPeriod);
+        uint32_t nLevel = pGpiMap[GPLEV0];
+        uint32_t nRising = nLevel & ~nLast;
+        uint32_t nFalling = ~nLevel & nLast;
+        nLast = nLevel;
+        uint64_t nNow = 0;
+        ribanRpiEdgeAwaiter* pReady = nullptr; // List of waiters to schedule
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if(m_nNextDeadline)
+                nNow = getTimeUs();
+            // Only scan waiters if an edge occurred or a timeout is due
+            if(!(nRising | nFalling) && !(m_nNextDeadline && nNow >= m_nNextDeadline))
+                continue;
+            m_nNextDeadline = 0;
+            ribanRpiEdgeAwaiter** ppWaiter = &m_pWaiters;
+            while(*ppWaiter)
+            {
+                ribanRpiEdgeAwaiter* pWaiter = *ppWaiter;
+                uint32_t nMatch = pWaiter->m_nMask & (((pWaiter->m_nEdge & GPI_EDGE_RISING) ? nRising : 0) | ((pWaiter->m_nEdge & GPI_EDGE_FALLING) ? nFalling : 0));
+                if(nMatch)
+                    pWaiter->m_nResult = __builtin_ctz(nMatch);
+                else if(pWaiter->m_nDeadline && nNow >= pWaiter->m_nDeadline)
+                    pWaiter->m_nResult = -1;
+                else
+                {
+                    if(pWaiter->m_nDeadline && (!m_nNextDeadline || pWaiter->m_nDeadline < m_nNextDeadline))
+                        m_nNextDeadline = pWaiter->m_nDeadline;
+                    ppWaiter = &pWaiter->m_pNext;
+                    continue;
+                }
+                // Move waiter to ready list
+                *ppWaiter = pWaiter->m_pNext;
+                pWaiter->m_pNext = pReady;
+                pReady = pWaiter;
+                --m_nPending;
+            }
+        }
+        // Schedule outside lock so that resumed coroutines may await again
+        while(pReady)
+        {
+            ribanRpiEdgeAwaiter* pNext = pReady->m_pNext;
+            if(m_scheduler)
+                m_scheduler(pReady->m_handle);
+            else
+                pReady->m_handle.resume();
+            pReady = pNext;
+        }
+    }
+}
@@ -0,0 +1,121 @@
+#pragma once
+#if !__cpp_impl_coroutine
+#error "ribanRpiEvents requires C++20 coroutine support (-std=c++20)"
+#endif
+#include "ribanRpiInterface.h"
+#include <coroutine> //Provides coroutine support (C++20)
+#include <functional> //Provides std::function
+#include <initializer_list> //Provides std::initializer_list
+#include <mutex> //Provides std::mutex
+#include <thread> //Provides std::thread
+#include <atomic> //Provides std::atomic
+
+//Edge types
+#define GPI_EDGE_RISING     0x01
+#define GPI_EDGE_FALLING    0x02
+#define GPI_EDGE_BOTH       0x03
+
+class ribanRpiEvents;
+
+/** Awaitable wait for an edge on one of a set of GPI pins<br/>
+    Created by ribanRpiEvents::edge and ribanRpiEvents::anyOf. Lives in the awaiting coroutine's frame so waiting does not allocate.
+*/
+class ribanRpiEdgeAwaiter
+{
+    public:
+        bool await_ready() const noexcept { return !m_nMask; } // Nothing to wait for (no valid GPI) so complete immediately with -1
+        void await_suspend(std::coroutine_handle<> handle);
+        /** @brief  Get result of wait
+        *   @retval int GPI pin number that triggered or -1 on timeout
+        */
+        int await_resume() const noexcept { return m_nResult; }
+
+    private:
+        friend class ribanRpiEvents;
+        ribanRpiEdgeAwaiter(ribanRpiEvents* pEvents, uint32_t nMask, uint8_t nEdge, uint32_t nTimeout) :
+            m_pEvents(pEvents), m_nMask(nMask), m_nEdge(nEdge), m_nTimeout(nTimeout) {};
+        ribanRpiEvents* m_pEvents; // Event engine
+        uint32_t m_nMask; // Bitmask of GPI pins to wait for
+        uint8_t m_nEdge; // Edge type [GPI_EDGE_RISING | GPI_EDGE_FALLING]
+        uint32_t m_nTimeout; // Timeout in milliseconds, 0 for none
+        uint64_t m_nDeadline = 0; // Time (us) at which wait times out, 0 for none
+        int m_nResult = -1; // GPI pin that triggered or -1 on timeout
+        std::coroutine_handle<> m_handle; // Suspended coroutine
+        ribanRpiEdgeAwaiter* m_pNext = nullptr; // Next waiter in engine list
+};
+
+/** Minimal fire-and-forget coroutine type for tasks that await GPI edges<br/>
+    Coroutine starts immediately and its frame is destroyed when it completes.
+*/
+struct ribanRpiTask
+{
+    struct promise_type
+    {
+        ribanRpiTask get_return_object() noexcept { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() noexcept {}
+        void unhandled_exception() noexcept { std::terminate(); }
+    };
+};
+
+/** Event engine resuming coroutines that await GPI edges<br/>
+    A single engine thread samples the GPI level register and hands coroutines whose edge has occurred, or whose timeout has expired,
+    to a scheduler supplied by the caller. Hundreds of concurrent waits share the engine thread with no busy waiting in the application.
+    Usage:
+        ribanRpiEvents events(rpi, [&](std::coroutine_handle<> h){ queue.push(h); });
+        int gpi = co_await events.edge(4, GPI_EDGE_FALLING, 1000);
+*/
+class ribanRpiEvents
+{
+    public:
+        typedef std::function<void(std::coroutine_handle<>)> Scheduler;
+
+        /** @brief  Create event engine
+        *   @param  rpi Initialised Raspberry Pi interface
+        *   @param  scheduler Function called from engine thread to schedule resumption of a coroutine [Default: resume on engine thread]
+        *   @param  nPeriod Sample period in microseconds [Default: 1000]
+        */
+        ribanRpiEvents(ribanRpiInterface& rpi, Scheduler scheduler = nullptr, uint32_t nPeriod = 1000);
+
+        /** @brief  Stop engine thread
+        *   @note   Pending waits are scheduled with timeout result
+        */
+        virtual ~ribanRpiEvents();
+
+        /** @brief  Await an edge on a GPI pin
+        *   @param  gpi GPI pin number [0..31] - other values complete immediately with -1
+        *   @param  nEdge Edge type [GPI_EDGE_RISING | GPI_EDGE_FALLING | GPI_EDGE_BOTH]
+        *   @param  nTimeout Timeout in milliseconds [Default: 0 - no timeout]
+        *   @retval ribanRpiEdgeAwaiter Awaitable returning gpi or -1 on timeout
+        */
+        ribanRpiEdgeAwaiter edge(uint8_t gpi, uint8_t nEdge = GPI_EDGE_BOTH, uint32_t nTimeout = 0);
+
+        /** @brief  Await an edge on any of a set of GPI pins
+        *   @param  gpis GPI pin numbers [0..31] - other values are ignored, completes immediately with -1 if none valid
+        *   @param  nEdge Edge type [GPI_EDGE_RISING | GPI_EDGE_FALLING | GPI_EDGE_BOTH]
+        *   @param  nTimeout Timeout in milliseconds [Default: 0 - no timeout]
+        *   @retval ribanRpiEdgeAwaiter Awaitable returning lowest numbered gpi that triggered or -1 on timeout
+        */
+        ribanRpiEdgeAwaiter anyOf(std::initializer_list<uint8_t> gpis, uint8_t nEdge = GPI_EDGE_BOTH, uint32_t nTimeout = 0);
+
+        /** @brief  Get quantity of pending waits
+        *   @retval uint32_t Quantity of suspended coroutines
+        */
+        uint32_t GetPending();
+
+    private:
+        friend class ribanRpiEdgeAwaiter;
+        void add(ribanRpiEdgeAwaiter* pAwaiter); // Register a waiter
+        void run(); // Engine thread
+        ribanRpiInterface& m_rpi;
+        Scheduler m_scheduler;
+        uint32_t m_nPeriod; // Sample period in microseconds
+        std::mutex m_mutex; // Protects waiter list
+        ribanRpiEdgeAwaiter* m_pWaiters = nullptr; // Intrusive list of pending waiters
+        uint32_t m_nPending = 0; // Quantity of pending waiters
+        uint64_t m_nNextDeadline = 0; // Earliest deadline of pending waiters, 0 for none
+        uint32_t m_nLevel; // GPI levels sampled at construction
+        std::atomic<bool> m_bRunning; // False to stop engine thread
+        std::thread m_thread; // Engine thread
+};
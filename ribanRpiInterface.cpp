@@ -1,4 +1,6 @@
 #include "ribanRpiInterface.h"
+#include "ribangpi_clib/board.h" //provides board probe and capabilities
+#include "ribangpi_clib/timing.h" //provides timestamp sources
 #include <unistd.h> //provide usleep
 #include <poll.h> //provides poll
 #include <fcntl.h> //provides file open constants
@@ -20,15 +22,7 @@
 #define GPLEN0      28
 #define GPAREN0     31
 #define GPAFEN0     34
-#define GPPUD       37
-#define GPPUDCLK0   38
-
-static const int8_t anUnavailableGpi[MAX_GPI] = {1,1,0,0,0,0,0,0,0,0,
-                                                0,0,0,0,0,0,0,0,0,0,
-                                                0,0,0,0,0,0,0,0,0,0,
-                                                0,0,1,1,1,1,1,1,1,1,
-                                                1,1,1,1,1,1,1,1,1,1,
-                                                1,1,1,1}; //Table of unavailable GPI pins
+#define PULL_SETUP_US   1 // Need to wait 150 cycles which is 0.6us on the slowest RPi so let's wait 1us
 
 class Debounce
 {
@@ -37,15 +31,21 @@ class Debounce
             nextTriggerTime(0),
             value(false)
         {};
-    time_t  nextTriggerTime;
+    uint64_t nextTriggerTime;
     bool    value;
 };
 
-ribanRpiInterface::ribanRpiInterface(uint64_t flags)
+ribanRpiInterface::ribanRpiInterface(uint64_t flags, const char* sGpiMem)
 {
     m_bUnInit = true;
+    m_pGpiMap = nullptr;
+    m_nAvailableGpi = getBoard()->caps->available;
+    m_bPullCntrl = false;
+    m_nPullReg = 0;
+    m_nFselRegs = 0;
+    getCounterNs(); //Calibrate timestamp counter so that first GetNanos is not delayed
     if(flags & RRPI_ENABLE_GPI)
-        initgpi();
+        initgpi(sGpiMem);
 }
 
 ribanRpiInterface::~ribanRpiInterface()
@@ -55,47 +55,25 @@ ribanRpiInterface::~ribanRpiInterface()
 
 std::string ribanRpiInterface::GetModel()
 {
-    int fd;
-    std::string sModel = "";
-    if((fd = open("/proc/device-tree/model", O_RDONLY) ) < 0)
-    {
-        return std::string("Unknown");
-    }
-    char c;
-    while(read(fd, &c, 1) > 0)
-        sModel += c;
-    close(fd);
-    return sModel;
+    return std::string(getBoard()->model);
 }
 
 uint8_t ribanRpiInterface::GetModelNumber()
 {
-    /* Model strings:
-        Raspberry Pi Model B Rev 2
-        Raspberry Pi 2 Model B Rev 1.1
-    */
-    std::string sModel = GetModel();
-    if(sModel.length() > 13)
-    {
-        uint8_t nModel = sModel[13] - 48; //!@todo Validate GetModelNumber works for each type of Raspberry Pi
-        if(nModel < 10)
-            return nModel;
-        else
-            return 1; // Raspberry Pi 1 does not have its number so assume non-numeric digit to be RPi 1
-    }
-    return -1;
+    return getBoard()->modelNumber;
 }
 
 bool ribanRpiInterface::GetGpi(uint8_t gpi, time_t debounce)
 {
-    if(m_bUnInit || gpi > MAX_GPI || anUnavailableGpi[gpi])
+    if(m_bUnInit || gpi > 31 || !(m_nAvailableGpi & (1UL << gpi)))
         return false;
     if(debounce)
     {
         static Debounce anDebounce[MAX_GPI]; // Only instantiate array of debounce structures if debounce is used
-        if(GetMillis() > anDebounce[gpi].nextTriggerTime)
+        uint64_t nNow = GetMillis();
+        if(nNow > anDebounce[gpi].nextTriggerTime)
         {
-            anDebounce[gpi].nextTriggerTime = GetMillis() + debounce;
+            anDebounce[gpi].nextTriggerTime = nNow + debounce;
             anDebounce[gpi].value = GetGpi(gpi);
         }
         else return anDebounce[gpi].value;
@@ -105,7 +83,7 @@ bool ribanRpiInterface::GetGpi(uint8_t gpi, time_t debounce)
 
 void ribanRpiInterface::SetGpi(uint8_t gpi, bool value)
 {
-    if(m_bUnInit || gpi > MAX_GPI || anUnavailableGpi[gpi])
+    if(m_bUnInit || gpi > 31 || !(m_nAvailableGpi & (1UL << gpi)))
         return;
     if(value)
         *(m_pGpiMap + GPSET0) = 1 << gpi;
@@ -115,25 +93,75 @@ void ribanRpiInterface::SetGpi(uint8_t gpi, bool value)
 
 bool ribanRpiInterface::ConfigureGpi(uint8_t gpi, uint8_t flags)
 {
-    if(m_bUnInit || gpi > MAX_GPI || anUnavailableGpi[gpi])
+    if(m_bUnInit || gpi > 31 || !(m_nAvailableGpi & (1UL << gpi)))
         return false;
+    return ConfigureGpiMask(1UL << gpi, flags);
+}
+
+bool ribanRpiInterface::ConfigureGpiMask(uint32_t mask, uint8_t flags)
+{
+    if(m_bUnInit || !mask)
+        return false;
+    for(uint8_t gpi = 0; gpi < 32; ++gpi)
+        if((mask & (1UL << gpi)) && !(m_nAvailableGpi & (1UL << gpi)))
+            return false;
     /*  There are 10 GPI configurations per register. Registers start at GPIO_BASE
         Each configuration consists of three bits defining mode
     */
-    //Clear configuration bits
-    *(m_pGpiMap + (gpi / 10)) &= ~(7 << ((gpi % 10) * 3)); //reset 3 flags for this gpi
-    //Set configuration bits to match requested mode
-    *(m_pGpiMap + (gpi / 10)) |= ((flags & 0x07) << ((gpi % 10) * 3)); //Configure for function
-    //Set pull-up/down flags then clock into selected pin
-    *(m_pGpiMap + GPPUD) = (flags & 0x18) >> 3;
-    usleep(1); //Need to wait 150 cycles which is 0.6us on the slowest RPi so let's wait 1us
-    *(m_pGpiMap + GPPUDCLK0 + (gpi / 32)) = 1 << (gpi % 32);
-    usleep(1); //Need to wait 150 cycles which is 0.6us on the slowest RPi so let's wait 1us
-    *(m_pGpiMap + GPPUD) = 0;
-    *(m_pGpiMap + GPPUDCLK0 + (gpi /32)) = 0;
+    for(uint8_t reg = 0; reg < m_nFselRegs; ++reg)
+    {
+        uint32_t nClear = 0, nSet = 0;
+        for(uint8_t gpi = reg * 10; gpi < reg * 10 + 10 && gpi < 32; ++gpi)
+        {
+            if(!(mask & (1UL << gpi)))
+                continue;
+            nClear |= 7 << ((gpi % 10) * 3);
+            nSet |= (flags & 0x07) << ((gpi % 10) * 3);
+        }
+        if(!nClear)
+            continue;
+        //Write only if configuration differs to avoid disturbing pins already configured
+        uint32_t nCurrent = *(m_pGpiMap + reg);
+        if(((nCurrent & ~nClear) | nSet) != nCurrent)
+            *(m_pGpiMap + reg) = (nCurrent & ~nClear) | nSet;
+    }
+    if(m_bPullCntrl)
+    {
+        //BCM2711 has 2 bits per GPI [00:none, 01:up, 10:down]
+        uint32_t nPull = (flags & GPI_INPUT_PULLUP) ? 1 : (flags & GPI_INPUT_PULLDOWN) ? 2 : 0;
+        for(uint8_t reg = 0; reg < 2; ++reg)
+        {
+            uint32_t nClear = 0, nSet = 0;
+            for(uint8_t bit = 0; bit < 16; ++bit)
+            {
+                if(!(mask & (1UL << (reg * 16 + bit))))
+                    continue;
+                nClear |= 3 << (bit * 2);
+                nSet |= nPull << (bit * 2);
+            }
+            if(!nClear)
+                continue;
+            uint32_t nCurrent = *(m_pGpiMap + m_nPullReg + reg);
+            if(((nCurrent & ~nClear) | nSet) != nCurrent)
+                *(m_pGpiMap + m_nPullReg + reg) = (nCurrent & ~nClear) | nSet;
+        }
+        return true;
+    }
+    //BCM2835 pull state cannot be read back so set pull-up/down flags (GPPUD) then clock into all selected pins (GPPUDCLK0)
+    *(m_pGpiMap + m_nPullReg) = (flags & 0x18) >> 3;
+    spinDelayUs(PULL_SETUP_US);
+    *(m_pGpiMap + m_nPullReg + 1) = mask;
+    spinDelayUs(PULL_SETUP_US);
+    *(m_pGpiMap + m_nPullReg) = 0;
+    *(m_pGpiMap + m_nPullReg + 1) = 0;
     return true;
 }
 
+volatile uint32_t* ribanRpiInterface::GetGpiMap()
+{
+    return m_bUnInit ? nullptr : m_pGpiMap;
+}
+
 bool ribanRpiInterface::IsInit()
 {
     return !m_bUnInit;
@@ -141,34 +169,40 @@ bool ribanRpiInterface::IsInit()
 
 time_t ribanRpiInterface::GetSeconds()
 {
-    clock_gettime(CLOCK_MONOTONIC_RAW, &m_ts);
-    return m_ts.tv_sec;
+    return getCoarseTimeMs() / 1000;
 }
 
 uint64_t ribanRpiInterface::GetMillis()
 {
-    clock_gettime(CLOCK_MONOTONIC_RAW, &m_ts);
-    return (uint64_t)m_ts.tv_sec * 1000 + (uint64_t)m_ts.tv_nsec / 1000000;
+    return getTimeMs();
 }
 
 uint64_t ribanRpiInterface::GetMicros()
 {
-    clock_gettime(CLOCK_MONOTONIC_RAW, &m_ts);
-    return (uint64_t)m_ts.tv_sec * 1000000 + (uint64_t)m_ts.tv_nsec / 1000;
+    return getTimeUs();
+}
+
+uint64_t ribanRpiInterface::GetNanos()
+{
+    return getCounterNs();
 }
 
-bool ribanRpiInterface::initgpi()
+bool ribanRpiInterface::initgpi(const char* sGpiMem)
 {
     if(!m_bUnInit)
         return true;
+    if(!getBoard()->caps->gpiomem)
+        return false; //SoC GPI registers not accessible via gpiomem
     int fd;
-    if((fd = open("/dev/gpiomem", O_RDWR|O_SYNC) ) < 0)
+    if((fd = open(sGpiMem, O_RDWR|O_SYNC) ) < 0)
         return false;
     m_pMap = mmap(NULL, BLOCK_SIZE, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
     close(fd); //Don't need the file open after memory map
     if(m_pMap != MAP_FAILED)
     {
         m_pGpiMap = (volatile uint32_t *)m_pMap;
+        m_bPullCntrl = getBoardPullScheme(m_pGpiMap, &m_nPullReg) == BOARD_PULL_DIRECT;
+        m_nFselRegs = getBoard()->caps->fselRegs;
         m_bUnInit = false;
     }
     return IsInit();
@@ -179,5 +213,6 @@ void ribanRpiInterface::uninitgpi()
     if(m_bUnInit)
         return;
     munmap(m_pMap, BLOCK_SIZE);
+    m_pGpiMap = nullptr;
     m_bUnInit = true;
 }
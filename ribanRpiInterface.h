@@ -33,8 +33,9 @@ class ribanRpiInterface
     public:
         /** @brief  Create riban Raspberry Pi interface object
         *   @param  flags Optional flags to enable / disable features
+        *   @param  sGpiMem Optional path of file to memory map for GPI register access, e.g. memory backed file for benchmarks
         */
-        ribanRpiInterface(uint64_t flags = RRPI_ENABLE_ALL);
+        ribanRpiInterface(uint64_t flags = RRPI_ENABLE_ALL, const char* sGpiMem = "/dev/gpiomem");
         virtual ~ribanRpiInterface();
 
         /** @brief  Get the Raspberry Pi model description
@@ -43,7 +44,8 @@ class ribanRpiInterface
         static std::string GetModel();
 
         /** @brief  Get Raspberry Pi model number
-        *   @retval uint8_t Model number [0,1,2 or 0xFF for unknown]
+        *   @retval uint8_t Model number [0 for Zero, 1..5 or 0xFF for unknown]
+        *   @note   Decoded from board type in revision code so Compute Module reports the model it is based on
         */
         static uint8_t GetModelNumber();
 
@@ -54,6 +56,15 @@ class ribanRpiInterface
         */
         bool ConfigureGpi(uint8_t gpi, uint8_t flags);
 
+        /** @brief  Configure several GPI pins with the same mode in one operation
+        *   @param  mask Bitmask of GPI pin numbers (bit 0 = GPI 0)
+        *   @param  flags Configuration flags [GPI_INPUT | GPI_INPUT_PULLDOWN | GPI_INPUT_PULLUP |GPI_OUTPUT]
+        *   @retval bool True on success, false if not initialised or mask includes unavailable pins
+        *   @note   Function select and BCM2711 pull registers are only written if they differ from requested configuration.
+        *           BCM2835 pulls cannot be read back so all pins in mask share one pull up/down sequence.
+        */
+        bool ConfigureGpiMask(uint32_t mask, uint8_t flags);
+
         /** @brief  Get the value of a GPI input
         *   @param  gpi GPI pin number
         *   @param  debounce Quantity of milliseconds to ignore changes [Default: none]
@@ -67,6 +78,12 @@ class ribanRpiInterface
         */
         void SetGpi(uint8_t gpi, bool value);
 
+        /** @brief  Get pointer to memory mapped GPI registers
+        *   @retval volatile uint32_t* Pointer to first GPI register or nullptr if not initialised
+        *   @note   Used by ribanRpiPin for direct register access
+        */
+        volatile uint32_t* GetGpiMap();
+
         /** @brief  Is library initialised?
         *   @retval bool True if library is initialised
         */
@@ -74,6 +91,7 @@ class ribanRpiInterface
 
         /** @brief  Get the quantity of seconds since epoch
         *   @retval time_t Quantity of seconds
+        *   @note   Uses coarse clock which is cheaper but only updated each scheduler tick
         */
         time_t GetSeconds();
 
@@ -89,13 +107,22 @@ class ribanRpiInterface
         */
         uint64_t GetMicros();
 
+        /** @brief  Get the quantity of nanoseconds from CPU counter
+        *   @retval uint64_t Quantity of nanoseconds
+        *   @note   Reads ARM generic timer (or TSC) without a syscall, suitable for timestamping every event
+        */
+        uint64_t GetNanos();
+
     protected:
 
     private:
-        bool initgpi(); //Initialises GPI returns true on success
+        bool initgpi(const char* sGpiMem); //Initialises GPI returns true on success
         void uninitgpi(); //Uninitalises GPI
         void * m_pMap; // Memory map of GPI area
         volatile uint32_t * m_pGpiMap; //Pointer to GPI map
         bool m_bUnInit; // False when initialised
-        timespec m_ts; // Time structure holds current time (updated by get time functions)
+        uint32_t m_nAvailableGpi; // Bitmask of GPI available on this board
+        bool m_bPullCntrl; // True if SoC has BCM2711 pull up/down registers
+        uint8_t m_nPullReg; // Word offset of first pull register
+        uint8_t m_nFselRegs; // Quantity of function select registers covering GPI 0-31
 };
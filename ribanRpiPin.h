@@ -0,0 +1,86 @@
+#pragma once
+#include "ribanRpiInterface.h"
+#include "ribangpi_clib/board.h" //Provides BOARD_GPI_AVAILABLE
+
+/** Compile-time specialised GPI pin handle<br/>
+    Pin number and mode are template parameters so register offset, bit mask and availability are resolved at compile time.
+    Invalid pins and writes to pins not configured as output fail to compile.
+    Each read is a single volatile load and each write a single volatile store so tight bit-bang loops run at MMIO speed.
+    Usage:
+        ribanRpiInterface rpi;
+        ribanRpiPin<4, GPI_OUTPUT> led(rpi);
+        led.Set(true);
+    The interface must be initialised (rpi.IsInit()) before a pin is created.
+*/
+template <uint8_t GPI, uint8_t MODE>
+class ribanRpiPin
+{
+    public:
+        static constexpr uint8_t MAX_GPI = 54;
+        static constexpr uint32_t REG_FSEL = GPI / 10; // Function select register
+        static constexpr uint32_t REG_SET = 7 + GPI / 32; // Output set register
+        static constexpr uint32_t REG_CLR = 10 + GPI / 32; // Output clear register
+        static constexpr uint32_t REG_LEV = 13 + GPI / 32; // Level register
+        static constexpr uint32_t MASK = 1UL << (GPI % 32); // Bit mask of pin within set, clear and level registers
+
+        /** @brief  Check if a GPI pin may be accessed by this library
+        *   @param  gpi GPI pin number
+        *   @retval bool True if pin is available
+        *   @note   Uses BOARD_GPI_AVAILABLE: GPI 0,1 are reserved for HAT EEPROM and GPI 28+ are not exposed
+        */
+        static constexpr bool IsAvailable(uint8_t gpi)
+        {
+            return gpi < 32 && (BOARD_GPI_AVAILABLE & (1UL << gpi));
+        }
+
+        static_assert(GPI < MAX_GPI, "GPI pin number out of range");
+        static_assert(IsAvailable(GPI), "GPI pin is not available");
+        static_assert((MODE & 0x07) != GPI_OUTPUT || !(MODE & (GPI_INPUT_PULLUP | GPI_INPUT_PULLDOWN)), "Pull resistor requires input mode");
+
+        /** @brief  Create pin handle
+        *   @param  rpi Initialised Raspberry Pi interface
+        *   @param  bConfigure True to configure pin function and pull resistor [Default: true]
+        */
+        explicit ribanRpiPin(ribanRpiInterface& rpi, bool bConfigure = true) :
+            m_pGpiMap(rpi.GetGpiMap())
+        {
+            if(bConfigure)
+                rpi.ConfigureGpi(GPI, MODE);
+        }
+
+        /** @brief  Get the value of the pin
+        *   @retval bool True if pin asserted
+        */
+        inline bool Get() const
+        {
+            return (m_pGpiMap[REG_LEV] & MASK) != 0;
+        }
+
+        /** @brief  Set the value of the pin
+        *   @param  value True to assert pin
+        */
+        inline void Set(bool value) const
+        {
+            static_assert((MODE & 0x07) == GPI_OUTPUT, "Pin is not configured as output");
+            m_pGpiMap[value ? REG_SET : REG_CLR] = MASK;
+        }
+
+        /** @brief  Assert the pin
+        */
+        inline void High() const
+        {
+            static_assert((MODE & 0x07) == GPI_OUTPUT, "Pin is not configured as output");
+            m_pGpiMap[REG_SET] = MASK;
+        }
+
+        /** @brief  Deassert the pin
+        */
+        inline void Low() const
+        {
+            static_assert((MODE & 0x07) == GPI_OUTPUT, "Pin is not configured as output");
+            m_pGpiMap[REG_CLR] = MASK;
+        }
+
+    private:
+        volatile uint32_t* const m_pGpiMap; // Pointer to memory mapped GPI registers
+};
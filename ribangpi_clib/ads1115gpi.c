@@ -0,0 +1,261 @@
+/*
+ * ******************************************************************
+ * ZYNTHIAN PROJECT: GPI Library
+ *
+ * Library for interfacing ADS1115 analog to digital converters with Zynthian
+ *
+ * Copyright (C) 2021 Brian Walton <riban@zynthian.org>
+ *
+ * ******************************************************************
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * For a full copy of the GNU General Public License see the LICENSE.txt file.
+ *
+ * ******************************************************************
+ */
+
+#include "ads1115gpi.h"
+#include "i2c.h" // Provides I2C interface
+#include "events.h" // Provides event queue
+#include "stats.h" // Provides instrumentation
+#include "timing.h" // Provides getCounterNs
+#include <string.h> // Provides memset, memmove
+
+#define ADS1115_POINTER_UNKNOWN 0xFF // Address pointer not known, e.g. after power cycle
+#define ADS1115_COMP_DISABLE    0x0003 // Comparator disabled, ALERT/RDY high impedance
+#define ADS1115_MUX_SINGLE(ch)  ((0x4 | (ch)) << 12) // Multiplexer: AINch to GND
+#define ADS1115_OSC_MARGIN      110 // Percentage of nominal conversion time to wait, allowing for +/-10% internal oscillator
+
+// Samples per second indexed by data rate
+static const uint16_t ads1115Rates[] = {8, 16, 32, 64, 128, 250, 475, 860};
+
+//  Structure describing an analog channel
+typedef struct adc_channel_t {
+    int32_t sum;            // Accumulated conversions awaiting decimation
+    uint8_t count;          // Quantity of conversions accumulated
+    uint8_t decimation;     // Quantity of conversions averaged into each sample
+    uint8_t reported;       // 1 if value has been reported
+    uint16_t hysteresis;    // Minimum change to report
+    int16_t value;          // Last reported value
+    uint32_t head;          // Index of next sample to write (free running, written by poll thread)
+    uint32_t tail;          // Index of next sample to read (free running, written by consumer)
+    int16_t samples[ADS1115_RING_SIZE]; // Ring of samples
+} adc_channel_t;
+
+//  Structure describing ADS1115 driver config
+typedef struct ads1115data_t {
+    uint8_t address;        // I2C address
+    i2c_health_t health;    // Health of device
+    uint16_t config;        // Configuration register excluding multiplexer
+    uint8_t channel;        // Channel currently selected by multiplexer
+    uint8_t pointer;        // Register addressed by device address pointer
+    uint8_t valid;          // 1 if multiplexer has been configured so conversion register holds a sample of channel
+    uint32_t conversionNs;  // Time to complete a conversion after multiplexer switch
+    uint64_t ready;         // Time (getCounterNs) at which conversion of newly selected channel completes
+    adc_channel_t channels[ADS1115_CHANNELS];
+} ads1115data_t;
+
+/*  Private helper functions */
+ads1115data_t* getAds1115Config(uint32_t driver); // Get a pointer to the driver's config data or NULL for invalid driver
+
+// Get channel of an analog GPI or NULL if not an analog input
+adc_channel_t* getAdcChannel(uint32_t gpi) {
+    if(gpi >= zynGpiCount)
+        return NULL;
+    ads1115data_t* config = getAds1115Config(gpimap[gpi].driver);
+    if(!config)
+        return NULL;
+    return &config->channels[gpimap[gpi].offset];
+}
+
+// Accumulate conversion, pushing sample when decimation is complete. Returns 1 if value changed by at least hysteresis.
+uint8_t pushAdcConversion(adc_channel_t* channel, uint32_t gpi, int16_t conversion) {
+    channel->sum += conversion;
+    if(++channel->count < channel->decimation)
+        return 0;
+    int16_t sample = channel->sum / channel->count;
+    channel->sum = 0;
+    channel->count = 0;
+    channel->samples[channel->head & (ADS1115_RING_SIZE - 1)] = sample;
+    __atomic_store_n(&channel->head, channel->head + 1, __ATOMIC_RELEASE);
+    int32_t delta = sample - channel->value;
+    uint32_t threshold = channel->hysteresis ? channel->hysteresis : 1; // Hysteresis 0 reports every change
+    if(channel->reported && (uint32_t)(delta < 0 ? -delta : delta) < threshold)
+        return 0;
+    channel->reported = 1;
+    __atomic_store_n(&channel->value, sample, __ATOMIC_RELAXED);
+    statsRecordEvent(gpi);
+    queueGpiEvent(gpi, GPI_EVENT_ANALOG, 0, sample);
+    return 1;
+}
+
+int addAds1115GpiDevice(uint8_t address, uint8_t gain, uint8_t rate) {
+    if(address < 0x48 || address > 0x4B || gain > ADS1115_PGA_0V256 || rate > ADS1115_RATE_860)
+        return -1;
+    lockGpiDrivers();
+    uint8_t driverCount;
+    for(driverCount = 0; driverCount < MAX_GPI_DRIVERS; ++driverCount) {
+        if(gpiDrivers[driverCount].type == GPI_DRIVER_NONE)
+            break;
+        ads1115data_t* existing = getAds1115Config(driverCount);
+        if(existing && existing->address == address) {
+            unlockGpiDrivers();
+            return driverCount;
+        }
+    }
+    if(driverCount >= MAX_GPI_DRIVERS || zynGpiCount + ADS1115_CHANNELS > MAX_GPI || i2cOpen() < 0) {
+        unlockGpiDrivers();
+        return -1;
+    }
+
+    gpi_driver_t* driver = &gpiDrivers[driverCount];
+    driver->type = GPI_DRIVER_ADS1115;
+    driver->size = ADS1115_CHANNELS;
+    driver->offset = zynGpiCount;
+    driver->config = (uint8_t*)malloc(sizeof(ads1115data_t));
+    ads1115data_t* config = (ads1115data_t*)driver->config;
+    memset(config, 0, sizeof(ads1115data_t));
+    config->address = address;
+    i2cHealthReset(&config->health);
+    // Continuous-conversion mode (MODE=0)
+    config->config = gain << 9 | rate << 5 | ADS1115_COMP_DISABLE;
+    config->pointer = ADS1115_POINTER_UNKNOWN; // Device is configured by first poll
+    config->conversionNs = 1000000000ULL * ADS1115_OSC_MARGIN / 100 / ads1115Rates[rate];
+    for(uint8_t channel = 0; channel < ADS1115_CHANNELS; ++channel)
+        config->channels[channel].decimation = 1;
+    driver->getStatus = getAds1115GpiStatus;
+    driver->gpis = (gpi_t*) malloc (driver->size * sizeof(gpi_t));
+    for(int i  = 0; i < driver->size; ++i) {
+        (driver->gpis[i]).value = 0;
+        (driver->gpis[i]).enabled = 0;
+        (driver->gpis[i]).dir = INPUT;
+        (driver->gpis[i]).rateClass = GPI_RATE_DEFAULT;
+        gpimap[zynGpiCount].driver = driverCount;
+        gpimap[zynGpiCount++].offset = i;
+    }
+    driver->poll = pollAds1115Gpi; // Assign last so that poll thread does not see partially populated driver
+    unlockGpiDrivers();
+    updatePolling();
+    return driverCount;
+}
+
+ads1115data_t* getAds1115Config(uint32_t driver) {
+    if(driver >= MAX_GPI_DRIVERS || gpiDrivers[driver].type != GPI_DRIVER_ADS1115)
+        return NULL;
+    return (ads1115data_t*)gpiDrivers[driver].config;
+}
+
+int setAdcFilter(uint32_t gpi, uint8_t decimation, uint16_t hysteresis) {
+    adc_channel_t* channel = getAdcChannel(gpi);
+    if(!channel || !decimation)
+        return -1;
+    lockGpiDrivers(); // Accumulator is owned by poll thread
+    channel->sum = 0;
+    channel->count = 0;
+    channel->decimation = decimation;
+    channel->hysteresis = hysteresis;
+    unlockGpiDrivers();
+    return 0;
+}
+
+uint32_t getAdcSamples(uint32_t gpi, int16_t* buffer, uint32_t max) {
+    adc_channel_t* channel = getAdcChannel(gpi);
+    if(!channel || !buffer)
+        return 0;
+    uint32_t head = __atomic_load_n(&channel->head, __ATOMIC_ACQUIRE);
+    uint32_t tail = channel->tail;
+    if(head - tail > ADS1115_RING_SIZE)
+        tail = head - ADS1115_RING_SIZE; // Oldest samples have been overwritten
+    uint32_t count = head - tail;
+    if(count > max)
+        count = max;
+    for(uint32_t i = 0; i < count; ++i)
+        buffer[i] = channel->samples[(tail + i) & (ADS1115_RING_SIZE - 1)];
+    // Discard samples overwritten by poll thread whilst copying
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    uint32_t lost = __atomic_load_n(&channel->head, __ATOMIC_RELAXED) - tail;
+    lost = lost > ADS1115_RING_SIZE ? lost - ADS1115_RING_SIZE : 0;
+    if(lost > count)
+        lost = count;
+    if(lost)
+        memmove(buffer, buffer + lost, (count - lost) * sizeof(int16_t));
+    channel->tail = tail + count;
+    return count - lost;
+}
+
+int16_t getAdcValue(uint32_t gpi) {
+    adc_channel_t* channel = getAdcChannel(gpi);
+    if(!channel)
+        return 0;
+    return __atomic_load_n(&channel->value, __ATOMIC_RELAXED);
+}
+
+uint8_t pollAds1115Gpi(uint32_t driver) {
+    ads1115data_t* config = getAds1115Config(driver);
+    if(!config || !i2cHealthReady(&config->health))
+        return 0;
+    // After a multiplexer switch the conversion register holds the previous channel until a full conversion completes
+    uint64_t now = getCounterNs();
+    if(config->valid && now < config->ready)
+        return 0;
+    gpi_driver_t* pDriver = &gpiDrivers[driver];
+    // Select next due channel after current channel
+    uint8_t next = ADS1115_CHANNELS;
+    for(uint8_t i = 1; i <= ADS1115_CHANNELS; ++i) {
+        uint8_t channel = (config->channel + i) % ADS1115_CHANNELS;
+        if(isGpiDue(pDriver->gpis[channel])) {
+            next = channel;
+            break;
+        }
+    }
+    if(next >= ADS1115_CHANNELS)
+        return 0; // No channels due
+
+    // Build single combined transaction: [set pointer] read conversion [write config selecting next channel]
+    uint8_t pointer = ADS1115_REG_CONVERSION;
+    uint8_t data[2];
+    uint16_t value = config->config | ADS1115_MUX_SINGLE(next);
+    uint8_t command[3] = {ADS1115_REG_CONFIG, value >> 8, value & 0xFF};
+    struct i2c_msg msgs[3];
+    uint8_t count = 0;
+    if(config->pointer != ADS1115_REG_CONVERSION)
+        msgs[count++] = (struct i2c_msg){config->address, 0, 1, &pointer};
+    msgs[count++] = (struct i2c_msg){config->address, I2C_M_RD, 2, data};
+    uint8_t reconfigure = !config->valid || next != config->channel;
+    if(reconfigure)
+        msgs[count++] = (struct i2c_msg){config->address, 0, 3, command};
+    int result = i2cTransfer(config->address, msgs, count);
+    if(i2cHealthUpdate(&config->health, result) || result < 0) {
+        // Device state unknown - address pointer and multiplexer are rewritten by next poll
+        config->pointer = ADS1115_POINTER_UNKNOWN;
+        config->valid = 0;
+        return 0;
+    }
+
+    uint8_t changed = 0;
+    uint8_t current = config->channel;
+    if(config->valid && pDriver->gpis[current].enabled)
+        changed = pushAdcConversion(&config->channels[current], pDriver->offset + current, (int16_t)(data[0] << 8 | data[1]));
+    config->pointer = reconfigure ? ADS1115_REG_CONFIG : ADS1115_REG_CONVERSION;
+    if(reconfigure)
+        config->ready = now + config->conversionNs;
+    config->channel = next;
+    config->valid = 1;
+    return changed;
+}
+
+uint8_t getAds1115GpiStatus(uint32_t driver) {
+    ads1115data_t* config = getAds1115Config(driver);
+    if(!config)
+        return GPI_STATUS_INVALID;
+    return config->health.status;
+}
@@ -0,0 +1,118 @@
+/*
+ * ******************************************************************
+ * ZYNTHIAN PROJECT: GPI Library
+ *
+ * Library for interfacing ADS1115 analog to digital converters with Zynthian
+ *
+ * Copyright (C) 2021 Brian Walton <riban@zynthian.org>
+ *
+ * ******************************************************************
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * For a full copy of the GNU General Public License see the LICENSE.txt file.
+ *
+ * ******************************************************************
+ */
+
+/*  ADS1115 16-bit ADC driver providing 4 single-ended analog inputs as GPI.
+    The device runs in continuous-conversion mode and is read by the poll thread, one channel per poll:
+        A single combined I2C_RDWR transaction reads the conversion register then, if more than one channel is enabled,
+        writes the configuration register to switch the multiplexer to the next channel.
+        With one channel enabled the address pointer is left at the conversion register so each poll is a 2 byte read.
+    After switching channel the read is deferred until a conversion time (1 / data rate) has passed so that each read follows
+    a complete conversion of the selected channel. Each enabled channel is sampled every n polls for n channels if the poll
+    period exceeds the conversion time, e.g. ADS1115_RATE_860 (1.2ms) with the default 10ms poll period, otherwise at
+    most once per conversion time per channel, e.g. ADS1115_RATE_8 (125ms) samples 4 channels every 500ms.
+
+    Channels are selected with enableGpi. Each sample (after optional decimation) is pushed to a per-channel ring which is
+    read lock-free by a single consumer with getAdcSamples. A GPI_EVENT_ANALOG event is queued when the value moves by at
+    least the hysteresis from the last reported value. GPI state (getState) is not used by analog inputs.
+
+    I2C address range 0x48..0x4B
+*/
+
+#ifndef ZYNADS1115GPI_H_INCLUDED
+#define ZYNADS1115GPI_H_INCLUDED
+
+#include "gpi.h"
+
+#define ADS1115_CHANNELS        4 // Quantity of single-ended inputs
+#define ADS1115_RING_SIZE       64 // Quantity of samples buffered per channel (power of 2)
+
+/*  Registers */
+#define ADS1115_REG_CONVERSION  0x00
+#define ADS1115_REG_CONFIG      0x01
+
+/*  Programmable gain - full scale range */
+#define ADS1115_PGA_6V144       0
+#define ADS1115_PGA_4V096       1
+#define ADS1115_PGA_2V048       2 // Power on default
+#define ADS1115_PGA_1V024       3
+#define ADS1115_PGA_0V512       4
+#define ADS1115_PGA_0V256       5
+
+/*  Data rate - samples per second */
+#define ADS1115_RATE_8          0
+#define ADS1115_RATE_16         1
+#define ADS1115_RATE_32         2
+#define ADS1115_RATE_64         3
+#define ADS1115_RATE_128        4 // Power on default
+#define ADS1115_RATE_250        5
+#define ADS1115_RATE_475        6
+#define ADS1115_RATE_860        7
+
+/** @brief  Instantiate an instance of an ADS1115 driver providing 4 analog inputs
+*   @param  address I2C address [0x48..0x4B]
+*   @param  gain Programmable gain [ADS1115_PGA_6V144..ADS1115_PGA_0V256]
+*   @param  rate Data rate [ADS1115_RATE_8..ADS1115_RATE_860]
+*   @retval int Index of new GPI driver or -1 on failure
+*   @note   Channels are disabled until enabled with enableGpi
+*/
+int addAds1115GpiDevice(uint8_t address, uint8_t gain, uint8_t rate);
+
+/** @brief  Configure filtering of an analog input
+*   @param  gpi Index of GPI within global gpimap
+*   @param  decimation Quantity of conversions averaged into each sample [1..255]
+*   @param  hysteresis Minimum change of sample from last reported value to raise an event, 0 to report every change
+*   @retval int 0 on success or -1 if GPI is not an analog input
+*/
+int setAdcFilter(uint32_t gpi, uint8_t decimation, uint16_t hysteresis);
+
+/** @brief  Retrieve buffered samples of an analog input without blocking
+*   @param  gpi Index of GPI within global gpimap
+*   @param  buffer Pointer to array to populate with samples, oldest first
+*   @param  max Quantity of samples buffer may hold
+*   @retval uint32_t Quantity of samples written to buffer
+*   @note   Single consumer per channel. Samples older than ADS1115_RING_SIZE are overwritten and not returned.
+*/
+uint32_t getAdcSamples(uint32_t gpi, int16_t* buffer, uint32_t max);
+
+/** @brief  Get last reported value of an analog input
+*   @param  gpi Index of GPI within global gpimap
+*   @retval int16_t Value last reported by event (subject to hysteresis), 0 if none or not an analog input
+*/
+int16_t getAdcValue(uint32_t gpi);
+
+/** @brief  Poll for change of value
+*   @param  driver Index of driver
+*   @retval uint8_t 1 if a value changed by at least its hysteresis else 0
+*/
+uint8_t pollAds1115Gpi(uint32_t driver);
+
+/** @brief  Get device status
+*   @param  driver Index of driver
+*   @retval uint8_t Status [GPI_STATUS_OK|GPI_STATUS_RETRY|GPI_STATUS_QUARANTINED|GPI_STATUS_INVALID]
+*/
+uint8_t getAds1115GpiStatus(uint32_t driver);
+
+//-----------------------------------------------------------------------------
+#endif // ZYNADS1115GPI_H_INCLUDED
@@ -0,0 +1,322 @@
+/*
+ * ******************************************************************
+ * ZYNTHIAN PROJECT: GPI Library
+ *
+ * Microbenchmark of GPI library hot paths
+ *
+ * Copyright (C) 2021 Brian Walton <riban@zynthian.org>
+ *
+ * ******************************************************************
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * For a full copy of the GNU General Public License see the LICENSE.txt file.
+ *
+ * ******************************************************************
+ */
+
+/*  Runs GPI library functions against a memory backed fake /dev/gpiomem.
+    Runs I2C and SPI expander functions against simulated MCP23017, PCF8574, riban I2C GPI, ADS1115 and MCP23S17 devices, reporting bus cost per operation.
+    Checks bus cost of key operations and MIDI bridge output bytes against expected values.
+    Usage: ribangpibench [iterations]
+    Exits with non-zero status if a check fails.
+*/
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE // Provides pipe2
+#endif
+
+#include "benchmark.h" // Provides benchmark harness
+#include "gpi.h"
+#include "rpigpi.h"
+#include "expandergpi.h"
+#include "ribani2cgpi.h"
+#include "ads1115gpi.h"
+#include "i2csim.h" // Provides simulated I2C and SPI devices
+#include "timing.h" // Provides timestamp sources
+#include "events.h" // Provides event queue
+#include "midi.h" // Provides MIDI bridge
+#include "stats.h" // Provides MIDI drop count
+#include <fcntl.h> // Provides open, O_NONBLOCK
+#include <unistd.h> // Provides pipe2, read, write
+#include <string.h> // Provides memcmp, memset
+#include <stdlib.h> // Provides atoi
+
+#define DEFAULT_ITERATIONS  1000000
+#define BUS_ITERATIONS      1000 // Bus cost is deterministic so fewer iterations are required
+#define MCP23017_ADDRESS    0x20
+#define PCF8574_ADDRESS     0x38
+#define RIBAN_ADDRESS       0x40
+#define ADS1115_ADDRESS     0x48
+#define ADS1115_CONVERSION_US   1300 // Conversion time at ADS1115_RATE_860 including oscillator margin
+#define MCP23S17_CS         0
+#define MCP23S17_HW         1
+#define MIDI_CHECK_SIZE     64 // Maximum quantity of bytes read by a MIDI check
+
+static i2csim_counters_t busCounters; // Simulated bus usage of last BENCHMARK_BUS
+static uint32_t busOps; // Quantity of operations run by last BENCHMARK_BUS
+
+/*  Run body the requested quantity of times and print simulated I2C bus cost per operation */
+#define BENCHMARK_BUS(name, iterations, body) do { \
+    i2cSimResetCounters(); \
+    for(uint32_t i = 0; i < (uint32_t)(iterations); ++i) { body; } \
+    i2cSimGetCounters(&busCounters); \
+    busOps = iterations; \
+    printf("%-32s %10u ops %8.2f transactions/op %8.2f bytes/op %10.1f bus-us/op\n", name, iterations, \
+        (double)busCounters.transactions / (iterations), (double)busCounters.bytes / (iterations), \
+        (double)busCounters.busNs / 1000 / (iterations)); \
+} while(0)
+
+/*  Read bytes written to MIDI pipe and compare with expected stream
+    Returns 0 if bytes match or 1 if they differ
+*/
+static int checkMidi(const char* name, int fd, const uint8_t* expected, int len) {
+    uint8_t buffer[MIDI_CHECK_SIZE];
+    int count = read(fd, buffer, sizeof(buffer));
+    if(count < 0)
+        count = 0; // Empty non-blocking pipe
+    int failed = count != len || memcmp(buffer, expected, len);
+    printf("%-32s %s", name, failed ? "FAILED got" : "ok");
+    for(int i = 0; failed && i < count; ++i)
+        printf(" %02X", buffer[i]);
+    printf("\n");
+    return failed;
+}
+
+/*  Compare bus cost of last BENCHMARK_BUS with expected cost per operation
+    Returns 0 if cost matches or 1 if it differs
+*/
+static int checkBus(uint32_t transactions, uint32_t bytes) {
+    if(busCounters.transactions == transactions * busOps && busCounters.bytes == bytes * busOps)
+        return 0;
+    printf("%-32s FAILED expected %u transactions/op %u bytes/op\n", "", transactions, bytes);
+    return 1;
+}
+
+int main(int argc, char* argv[]) {
+    uint32_t iterations = argc > 1 ? atoi(argv[1]) : DEFAULT_ITERATIONS;
+    if(!iterations)
+        iterations = DEFAULT_ITERATIONS;
+    int failures = 0;
+    char path[FAKE_GPIMEM_PATH_LEN];
+    volatile uint32_t* regs;
+    if(createFakeGpiMem(path, &regs) < 0) {
+        fprintf(stderr, "Failed to create fake GPI register file\n");
+        return -1;
+    }
+    setRpiGpiMemDevice(path);
+    int driver = addRpiGpiDevice();
+    if(driver < 0) {
+        fprintf(stderr, "Failed to add RPi GPI driver\n");
+        return -1;
+    }
+    for(uint32_t gpi = 2; gpi < 28; ++gpi)
+        enableGpi(gpi, 1);
+
+    printf("riban GPI library benchmark (%u iterations)\n", iterations);
+    BENCHMARK("getTimeNs", iterations, benchmarkSink += getTimeNs());
+    BENCHMARK("getCoarseTimeMs", iterations, benchmarkSink += getCoarseTimeMs());
+    BENCHMARK("getCounterNs", iterations, benchmarkSink += getCounterNs());
+    BENCHMARK("getState", iterations, benchmarkSink += getState(i & 0x1F));
+    BENCHMARK("setState", iterations, setState(4 + (i & 0x0F), i & 1));
+    BENCHMARK("setDirection", iterations, setDirection(4 + (i & 0x0F), i & 1));
+    BENCHMARK("pollRpiGpi (no change)", iterations, benchmarkSink += pollRpiGpi(driver));
+    BENCHMARK("pollRpiGpi (all change)", iterations, regs[BCM2835_GPLEV0] = (i & 1) ? 0x0FFFFFFC : 0; benchmarkSink += pollRpiGpi(driver));
+    enableGpiEvents(1);
+    gpi_event_t events[GPI_EVENT_QUEUE_SIZE];
+    uint32_t changed[GPI_EVENT_BITMAP_WORDS];
+    BENCHMARK("pollRpiGpi (all change, queued)", iterations, regs[BCM2835_GPLEV0] = (i & 1) ? 0x0FFFFFFC : 0; benchmarkSink += pollRpiGpi(driver));
+    BENCHMARK("pollRpiGpi + getGpiEvents", iterations, regs[BCM2835_GPLEV0] = (i & 1) ? 0x0FFFFFFC : 0; pollRpiGpi(driver);
+        benchmarkSink += getGpiEvents(changed, events, GPI_EVENT_QUEUE_SIZE));
+    enableGpiEvents(0);
+    int midiFd = open("/dev/null", O_WRONLY);
+    setMidiOutput(midiFd);
+    for(uint32_t gpi = 2; gpi < 28; ++gpi)
+        addMidiMap(gpi, MIDI_MAP_NOTE, 0, 36 + gpi, 100, 1);
+    BENCHMARK("pollRpiGpi + MIDI (26 notes)", iterations, regs[BCM2835_GPLEV0] = (i & 1) ? 0x0FFFFFFC : 0; pollRpiGpi(driver);
+        flushMidi());
+    clearMidiMaps();
+    setMidiOutput(-1);
+    close(midiFd);
+    BENCHMARK("setPull", iterations / 1000, setPull(4 + (i & 0x0F), PUD_UP));
+    BENCHMARK("setRpiGpiPullMask (26 GPI)", iterations / 1000, setRpiGpiPullMask(0x0FFFFFFC, (i & 1) ? PUD_UP : PUD_OFF));
+
+    printf("\nMIDI output check\n");
+    int midiPipe[2];
+    if(pipe2(midiPipe, O_NONBLOCK) < 0) {
+        fprintf(stderr, "Failed to create MIDI pipe\n");
+        return -1;
+    }
+    regs[BCM2835_GPLEV0] = 0;
+    pollRpiGpi(driver); // Encoder inputs start low
+    setMidiOutput(midiPipe[1]);
+    addMidiMap(4, MIDI_MAP_NOTE, 0, 60, 100, 0);
+    addMidiMap(5, MIDI_MAP_NOTE, 0, 62, 100, 0);
+    midiGpiChange(4, 1);
+    midiGpiChange(5, 1);
+    midiGpiChange(4, 0);
+    flushMidi();
+    const uint8_t runningStatus[] = {0x90, 60, 100, 62, 100, 60, 0};
+    failures += checkMidi("Running status, note off", midiPipe[0], runningStatus, sizeof(runningStatus));
+    midiGpiChange(5, 0);
+    flushMidi();
+    const uint8_t nextBatch[] = {0x90, 62, 0};
+    failures += checkMidi("Status restarts each batch", midiPipe[0], nextBatch, sizeof(nextBatch));
+    addMidiEncoderMap(6, 7, 1, 1, 20, 0);
+    const uint8_t clockwise[][2] = {{6, 1}, {7, 1}, {6, 0}, {7, 0}}; // A leads B
+    const uint8_t anticlockwise[][2] = {{7, 1}, {6, 1}, {7, 0}, {6, 0}}; // B leads A
+    for(uint32_t step = 0; step < 4; ++step)
+        midiGpiChange(clockwise[step][0], clockwise[step][1]);
+    for(uint32_t step = 0; step < 4; ++step)
+        midiGpiChange(anticlockwise[step][0], anticlockwise[step][1]);
+    flushMidi();
+    const uint8_t relative[] = {0xB1, 20, 65, 20, 63};
+    failures += checkMidi("Relative encoder", midiPipe[0], relative, sizeof(relative));
+    // Fill pipe so that next batch cannot be written
+    uint8_t fill[MIDI_CHECK_SIZE];
+    memset(fill, 0, sizeof(fill));
+    while(write(midiPipe[1], fill, sizeof(fill)) > 0);
+    while(write(midiPipe[1], fill, 1) > 0); // Small writes are atomic so fill remaining space byte by byte
+    gpi_stats_t before, after;
+    getStats(&before);
+    midiGpiChange(4, 1);
+    flushMidi();
+    getStats(&after);
+    uint32_t dropped = after.midiDropped - before.midiDropped;
+    printf("%-32s %s (%u bytes dropped)\n", "Drop when output full", dropped == 3 ? "ok" : "FAILED", dropped);
+    failures += dropped != 3;
+    clearMidiMaps();
+    setMidiOutput(-1);
+    close(midiPipe[0]);
+    close(midiPipe[1]);
+
+    printf("\nSimulated MCP23017 bus cost\n");
+    i2cSetTransport(&i2cSimTransport);
+    i2cSimAddMcp23017(MCP23017_ADDRESS);
+    int mcp = -1;
+    BENCHMARK_BUS("addMcp23017GpiDevice", 1, mcp = addMcp23017GpiDevice(MCP23017_ADDRESS, 0));
+    if(mcp < 0) {
+        fprintf(stderr, "Failed to add MCP23017 GPI driver\n");
+        return -1;
+    }
+    uint32_t first = gpiDrivers[mcp].offset;
+    for(uint32_t gpi = first; gpi < first + 16; ++gpi)
+        enableGpi(gpi, 1);
+    lockGpiDrivers(); // Stop poll thread from adding to bus cost
+    BENCHMARK_BUS("pollExpanderGpi", BUS_ITERATIONS, pollExpanderGpi(mcp));
+    failures += checkBus(1, 5); // Address, register, address, 2 ports read in one combined transaction
+    gpiDueClasses = 1 << 1; // Only port B GPI are in a due rate class
+    for(uint32_t gpi = first + 8; gpi < first + 16; ++gpi)
+        setGpiRate(gpi, 1);
+    BENCHMARK_BUS("pollExpanderGpi (port B due)", BUS_ITERATIONS, pollExpanderGpi(mcp));
+    failures += checkBus(1, 4);
+    gpiDueClasses = GPI_RATE_ALL;
+    for(uint32_t gpi = first + 8; gpi < first + 16; ++gpi)
+        setGpiRate(gpi, GPI_RATE_DEFAULT);
+    BENCHMARK_BUS("setState", BUS_ITERATIONS, setState(first + (i & 0x0F), i & 1));
+    failures += checkBus(1, 3);
+    BENCHMARK_BUS("setDirection", BUS_ITERATIONS, setDirection(first + (i & 0x0F), i & 1));
+    BENCHMARK_BUS("setPull", BUS_ITERATIONS, setPull(first + (i & 0x0F), PUD_UP));
+    // LED animation frame: update all 16 outputs then let poll cycle write them
+    BENCHMARK_BUS("16 x setState (immediate)", BUS_ITERATIONS, for(uint32_t pin = 0; pin < 16; ++pin) setState(first + pin, (i + pin) & 1));
+    failures += checkBus(16, 48);
+    setGpiWriteBehind(1);
+    BENCHMARK_BUS("16 x setState (write-behind)", BUS_ITERATIONS,
+        for(uint32_t pin = 0; pin < 16; ++pin) setState(first + pin, (i + pin) & 1); flushExpanderGpi(mcp));
+    failures += checkBus(1, 4); // Both output latches written in one transaction
+    gpi_config_t desired = {0xFFFF, 0x00FF, 0xFF00, 0}; // Port A outputs, port B inputs with pull-ups
+    BENCHMARK_BUS("configureExpanderGpi (changed)", 1, configureExpanderGpi(mcp, &desired));
+    int writes = 0;
+    BENCHMARK_BUS("configureExpanderGpi (same)", BUS_ITERATIONS, writes += configureExpanderGpi(mcp, &desired));
+    failures += checkBus(2, 10); // Read back of pull-up and direction registers only
+    if(writes) {
+        printf("%-32s FAILED expected no register writes, got %d\n", "", writes);
+        ++failures;
+    }
+    unlockGpiDrivers();
+    setGpiWriteBehind(0);
+
+    printf("\nSimulated PCF8574 bus cost\n");
+    i2cSimAddPcf8574(PCF8574_ADDRESS);
+    int pcf = -1;
+    BENCHMARK_BUS("addPcf8574GpiDevice", 1, pcf = addPcf8574GpiDevice(PCF8574_ADDRESS));
+    if(pcf < 0) {
+        fprintf(stderr, "Failed to add PCF8574 GPI driver\n");
+        return -1;
+    }
+    first = gpiDrivers[pcf].offset;
+    for(uint32_t gpi = first; gpi < first + 8; ++gpi)
+        enableGpi(gpi, 1);
+    lockGpiDrivers();
+    BENCHMARK_BUS("pollExpanderGpi", BUS_ITERATIONS, pollExpanderGpi(pcf));
+    failures += checkBus(1, 2);
+    BENCHMARK_BUS("setState", BUS_ITERATIONS, setState(first + (i & 0x07), i & 1));
+    unlockGpiDrivers();
+
+    printf("\nSimulated riban I2C GPI bus cost\n");
+    i2cSimAddRiban(RIBAN_ADDRESS);
+    int riban = -1;
+    BENCHMARK_BUS("addRibanGpiDevice", 1, riban = addRibanGpiDevice(RIBAN_ADDRESS));
+    if(riban < 0) {
+        fprintf(stderr, "Failed to add riban I2C GPI driver\n");
+        return -1;
+    }
+    first = gpiDrivers[riban].offset;
+    for(uint32_t gpi = first; gpi < first + RIBAN_I2C_GPI_COUNT; ++gpi)
+        enableGpi(gpi, 1);
+    lockGpiDrivers();
+    pollRibanGpi(riban); // Read initial levels
+    BENCHMARK_BUS("pollRibanGpi (idle)", BUS_ITERATIONS, pollRibanGpi(riban));
+    failures += checkBus(1, 5);
+    BENCHMARK_BUS("pollRibanGpi (changing)", BUS_ITERATIONS, (i2cSimSetInputs(RIBAN_ADDRESS, i), pollRibanGpi(riban)));
+    BENCHMARK_BUS("setState", BUS_ITERATIONS, setState(first + (i % RIBAN_I2C_GPI_COUNT), i & 1));
+    BENCHMARK_BUS("setRibanGpiOutputs (50 GPI)", BUS_ITERATIONS, setRibanGpiOutputs(riban, RIBAN_I2C_BITMAP_MASK, i));
+    unlockGpiDrivers();
+
+    printf("\nSimulated ADS1115 bus cost\n");
+    i2cSimAddAds1115(ADS1115_ADDRESS);
+    int adc = addAds1115GpiDevice(ADS1115_ADDRESS, ADS1115_PGA_4V096, ADS1115_RATE_860);
+    if(adc < 0) {
+        fprintf(stderr, "Failed to add ADS1115 driver\n");
+        return -1;
+    }
+    first = gpiDrivers[adc].offset;
+    enableGpi(first, 1);
+    lockGpiDrivers();
+    pollAds1115Gpi(adc); // Configure multiplexer
+    usleep(ADS1115_CONVERSION_US); // Wait for conversion of selected channel
+    BENCHMARK_BUS("pollAds1115Gpi (1 channel)", BUS_ITERATIONS, (i2cSimSetAnalog(ADS1115_ADDRESS, 0, i), pollAds1115Gpi(adc)));
+    for(uint32_t gpi = first; gpi < first + ADS1115_CHANNELS; ++gpi)
+        enableGpi(gpi, 1);
+    BENCHMARK_BUS("pollAds1115Gpi (4 channels)", BUS_ITERATIONS, usleep(ADS1115_CONVERSION_US); pollAds1115Gpi(adc));
+    unlockGpiDrivers();
+
+    printf("\nSimulated MCP23S17 bus cost\n");
+    spiSetTransport(&spiSimTransport);
+    i2cSimAddMcp23S17(MCP23S17_CS, MCP23S17_HW);
+    int spi = -1;
+    BENCHMARK_BUS("addMcp23S17GpiDevice", 1, spi = addMcp23S17GpiDevice(MCP23S17_CS, MCP23S17_HW, 0));
+    if(spi < 0) {
+        fprintf(stderr, "Failed to add MCP23S17 GPI driver\n");
+        return -1;
+    }
+    first = gpiDrivers[spi].offset;
+    for(uint32_t gpi = first; gpi < first + 16; ++gpi)
+        enableGpi(gpi, 1);
+    lockGpiDrivers();
+    BENCHMARK_BUS("pollExpanderGpi", BUS_ITERATIONS, pollExpanderGpi(spi));
+    failures += checkBus(1, 4);
+    BENCHMARK_BUS("setState", BUS_ITERATIONS, setState(first + (i & 0x0F), i & 1));
+    unlockGpiDrivers();
+
+    shutdownGpi();
+    return failures ? 1 : 0;
+}
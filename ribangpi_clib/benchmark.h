@@ -0,0 +1,149 @@
+/*
+ * ******************************************************************
+ * ZYNTHIAN PROJECT: GPI Library
+ *
+ * Microbenchmark helpers shared by library and C++ interface benchmarks
+ *
+ * Copyright (C) 2021 Brian Walton <riban@zynthian.org>
+ *
+ * ******************************************************************
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * For a full copy of the GNU General Public License see the LICENSE.txt file.
+ *
+ * ******************************************************************
+ */
+
+/*  Benchmarks run against a memory backed file standing in for /dev/gpiomem so they may be run on any Linux host.
+    Each benchmark reports time, heap allocations and CPU cache misses per operation.
+    Cache misses are read from perf_event_open and reported as "n/a" if performance counters are unavailable.
+    Include this header in exactly one source file of a benchmark executable - it interposes malloc to count allocations.
+*/
+
+#ifndef ZYNBENCHMARK_H_INCLUDED
+#define ZYNBENCHMARK_H_INCLUDED
+
+#include "fakegpimem.h" // Provides memory backed /dev/gpiomem
+#include <stdint.h> // Provides fixed width integer types
+#include <stdio.h> // Provides printf
+#include <stdlib.h> // Provides malloc declarations which are interposed below
+#include <string.h> // Provides memset
+#include <time.h> // Provides clock_gettime
+#include <unistd.h> // Provides syscall
+#include <sys/syscall.h> // Provides SYS_perf_event_open
+#include <sys/ioctl.h> // Provides ioctl
+#include <linux/perf_event.h> // Provides perf event definitions
+
+#ifdef __cplusplus
+#define BENCHMARK_NOEXCEPT noexcept // Must match exception specification of C library declaration
+extern "C" {
+#else
+#define BENCHMARK_NOEXCEPT
+#endif
+
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t count, size_t size);
+extern void* __libc_realloc(void* ptr, size_t size);
+
+static uint64_t benchmarkAllocations = 0; // Quantity of heap allocations since start of process
+
+void* malloc(size_t size) BENCHMARK_NOEXCEPT {
+    __atomic_fetch_add(&benchmarkAllocations, 1, __ATOMIC_RELAXED);
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) BENCHMARK_NOEXCEPT {
+    __atomic_fetch_add(&benchmarkAllocations, 1, __ATOMIC_RELAXED);
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* ptr, size_t size) BENCHMARK_NOEXCEPT {
+    __atomic_fetch_add(&benchmarkAllocations, 1, __ATOMIC_RELAXED);
+    return __libc_realloc(ptr, size);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+//  Structure describing a running benchmark
+typedef struct benchmark_t {
+    uint64_t start;         // Start time in nanoseconds
+    uint64_t allocations;   // Allocation count at start
+    int perfFd;             // File descriptor of cache miss counter or -1 if unavailable
+} benchmark_t;
+
+static volatile uint32_t benchmarkSink; // Destination for results so that benchmarked code is not optimised away
+
+/** @brief  Get monotonic time
+*   @retval uint64_t Nanoseconds since arbitrary epoch
+*/
+static inline uint64_t benchmarkGetNanos() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/** @brief  Start measuring a benchmark
+*   @param  benchmark Pointer to benchmark structure
+*/
+static inline void benchmarkStart(benchmark_t* benchmark) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_CACHE_MISSES;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    benchmark->perfFd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    if(benchmark->perfFd >= 0) {
+        ioctl(benchmark->perfFd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(benchmark->perfFd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+    benchmark->allocations = __atomic_load_n(&benchmarkAllocations, __ATOMIC_RELAXED);
+    benchmark->start = benchmarkGetNanos();
+}
+
+/** @brief  Stop measuring a benchmark and print results
+*   @param  benchmark Pointer to benchmark structure
+*   @param  name Name of benchmark
+*   @param  iterations Quantity of operations performed
+*/
+static inline void benchmarkStop(benchmark_t* benchmark, const char* name, uint32_t iterations) {
+    uint64_t elapsed = benchmarkGetNanos() - benchmark->start;
+    uint64_t allocations = __atomic_load_n(&benchmarkAllocations, __ATOMIC_RELAXED) - benchmark->allocations;
+    printf("%-32s %10u ops %12.1f ns/op %8.3f allocs/op", name, iterations,
+        (double)elapsed / iterations, (double)allocations / iterations);
+    if(benchmark->perfFd >= 0) {
+        uint64_t misses = 0;
+        ioctl(benchmark->perfFd, PERF_EVENT_IOC_DISABLE, 0);
+        if(read(benchmark->perfFd, &misses, sizeof(misses)) == sizeof(misses))
+            printf(" %10.3f cache-misses/op\n", (double)misses / iterations);
+        else
+            printf(" %10s cache-misses/op\n", "n/a");
+        close(benchmark->perfFd);
+    } else {
+        printf(" %10s cache-misses/op\n", "n/a");
+    }
+}
+
+/*  Run body the requested quantity of times, with loop index i, and print results */
+#define BENCHMARK(name, iterations, body) do { \
+    benchmark_t benchmark; \
+    benchmarkStart(&benchmark); \
+    for(uint32_t i = 0; i < (uint32_t)(iterations); ++i) { body; } \
+    benchmarkStop(&benchmark, name, iterations); \
+} while(0)
+
+//-----------------------------------------------------------------------------
+#endif // ZYNBENCHMARK_H_INCLUDED
@@ -0,0 +1,148 @@
+/*
+ * ******************************************************************
+ * ZYNTHIAN PROJECT: GPI Library
+ *
+ * Raspberry Pi board probe and per-SoC capability tables
+ *
+ * Copyright (C) 2021 Brian Walton <riban@zynthian.org>
+ *
+ * ******************************************************************
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * For a full copy of the GNU General Public License see the LICENSE.txt file.
+ *
+ * ******************************************************************
+ */
+
+#include "board.h"
+#include <fcntl.h> // Provides open
+#include <unistd.h> // Provides read, close
+#include <string.h> // Provides strncpy, strstr
+#include <stdlib.h> // Provides strtoul
+#include <pthread.h> // Provides pthread_once
+
+#define REVISION_NEW_STYLE  0x00800000 // Revision code bit indicating new style encoding
+#define CPUINFO_SIZE        4096 // Size of buffer for /proc/cpuinfo
+#define MODEL_UNKNOWN       0xFF // Model number for unknown board type
+#define GPIO_MAGIC          0x6770696f // "gpio" - value of unimplemented registers on BCM2835 family
+#define PULL_PROBE_REG      3 // Offset from GPPUPPDN0 of last BCM2711 pull register, unimplemented on BCM2835 family
+
+//  Capability tables indexed by SoC identifier
+static const board_caps_t socCaps[] = {
+    {"BCM2835", BOARD_GPI_AVAILABLE, 4, BOARD_PULL_GPPUD, 37, 1},
+    {"BCM2836", BOARD_GPI_AVAILABLE, 4, BOARD_PULL_GPPUD, 37, 1},
+    {"BCM2837", BOARD_GPI_AVAILABLE, 4, BOARD_PULL_GPPUD, 37, 1},
+    {"BCM2711", BOARD_GPI_AVAILABLE, 4, BOARD_PULL_DIRECT, 57, 1},
+    {"BCM2712", 0, 0, BOARD_PULL_DIRECT, 0, 0} // GPI is on RP1 which is not supported
+};
+static const board_caps_t unknownCaps = {"Unknown", BOARD_GPI_AVAILABLE, 4, BOARD_PULL_PROBE, 37, 1};
+
+//  Model numbers indexed by new style revision code type field (bits 4-11). Zero reports 0, Compute Module reports the model it is based on.
+static const uint8_t typeModel[] = {
+    1, 1, 1, 1,             // 0x00 A, B, A+, B+
+    2, 1, 1, MODEL_UNKNOWN, // 0x04 2B, Alpha, CM1, unused
+    3, 0, 3, MODEL_UNKNOWN, // 0x08 3B, Zero, CM3, unused
+    0, 3, 3, MODEL_UNKNOWN, // 0x0C Zero W, 3B+, 3A+, internal
+    3, 4, 0, 4,             // 0x10 CM3+, 4B, Zero 2 W, 400
+    4, 4, MODEL_UNKNOWN, 5, // 0x14 CM4, CM4S, internal, 5
+    5, 5, 5                 // 0x18 CM5, 500, CM5 Lite
+};
+
+static board_t board;
+static pthread_once_t boardOnce = PTHREAD_ONCE_INIT;
+
+/*  Read up to size - 1 bytes of a file with a single read and null terminate
+    Returns quantity of bytes read or -1 on failure
+*/
+static int readFile(const char* path, char* buffer, int size) {
+    int fd = open(path, O_RDONLY);
+    if(fd < 0)
+        return -1;
+    int len = read(fd, buffer, size - 1);
+    close(fd);
+    if(len < 0)
+        return -1;
+    buffer[len] = 0;
+    return len;
+}
+
+static uint32_t probeRevision() {
+    unsigned char code[4];
+    int fd = open("/proc/device-tree/system/linux,revision", O_RDONLY);
+    if(fd >= 0) {
+        int len = read(fd, code, sizeof(code));
+        close(fd);
+        if(len == sizeof(code))
+            return (code[0] << 24) | (code[1] << 16) | (code[2] << 8) | code[3]; // Big endian
+    }
+    char cpuinfo[CPUINFO_SIZE];
+    if(readFile("/proc/cpuinfo", cpuinfo, sizeof(cpuinfo)) <= 0)
+        return 0;
+    char* revision = strstr(cpuinfo, "Revision");
+    if(!revision || !(revision = strchr(revision, ':')))
+        return 0;
+    return strtoul(revision + 1, NULL, 16);
+}
+
+static void probeBoard() {
+    if(readFile("/proc/device-tree/model", board.model, sizeof(board.model)) <= 0)
+        strcpy(board.model, "Unknown");
+    board.revision = probeRevision();
+    board.soc = BOARD_SOC_UNKNOWN;
+    if(board.revision & REVISION_NEW_STYLE)
+        board.soc = (board.revision >> 12) & 0x0F;
+    else if(board.revision)
+        board.soc = BOARD_SOC_BCM2835; // Old style revision codes are only used by Raspberry Pi 1
+    if(board.soc < sizeof(socCaps) / sizeof(board_caps_t)) {
+        board.caps = &socCaps[board.soc];
+    } else {
+        board.soc = BOARD_SOC_UNKNOWN;
+        board.caps = &unknownCaps;
+    }
+    board.modelNumber = MODEL_UNKNOWN;
+    uint32_t type = (board.revision >> 4) & 0xFF;
+    if(board.revision & REVISION_NEW_STYLE) {
+        if(type < sizeof(typeModel))
+            board.modelNumber = typeModel[type];
+    } else if(board.revision) {
+        board.modelNumber = 1; // Old style revision codes are only used by Raspberry Pi 1
+    }
+    if(board.modelNumber == MODEL_UNKNOWN && strlen(board.model) > 13) {
+        /* Model strings:
+            Raspberry Pi Model B Rev 2
+            Raspberry Pi 2 Model B Rev 1.1
+            Raspberry Pi Zero 2 W Rev 1.0
+        */
+        uint8_t model = board.model[13] - 48;
+        if(model < 10)
+            board.modelNumber = model;
+        else if(board.model[13] == 'Z')
+            board.modelNumber = 0;
+        else if(board.model[13] == 'M')
+            board.modelNumber = 1; // Raspberry Pi 1 does not have its number
+    }
+}
+
+const board_t* getBoard() {
+    pthread_once(&boardOnce, probeBoard);
+    return &board;
+}
+
+uint8_t getBoardPullScheme(volatile uint32_t* regs, uint8_t* pullReg) {
+    const board_caps_t* caps = getBoard()->caps;
+    if(caps->pullScheme == BOARD_PULL_PROBE) {
+        const board_caps_t* direct = &socCaps[BOARD_SOC_BCM2711];
+        caps = regs[direct->pullReg + PULL_PROBE_REG] != GPIO_MAGIC ? direct : &socCaps[BOARD_SOC_BCM2835];
+    }
+    *pullReg = caps->pullReg;
+    return caps->pullScheme;
+}
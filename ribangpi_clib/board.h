@@ -0,0 +1,100 @@
+/*
+ * ******************************************************************
+ * ZYNTHIAN PROJECT: GPI Library
+ *
+ * Raspberry Pi board probe and per-SoC capability tables
+ *
+ * Copyright (C) 2021 Brian Walton <riban@zynthian.org>
+ *
+ * ******************************************************************
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * For a full copy of the GNU General Public License see the LICENSE.txt file.
+ *
+ * ******************************************************************
+ */
+
+/*  The board is probed once, on first call to getBoard(), reading model description and revision code with a single read() each.
+    The revision code selects a capability table for the SoC which is shared by the C library and C++ bindings.
+*/
+
+#ifndef ZYNBOARD_H_INCLUDED
+#define ZYNBOARD_H_INCLUDED
+
+#include <stdint.h> // Provides fixed width integer types
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//  SoC identifiers (processor field of new style revision code)
+#define BOARD_SOC_BCM2835   0
+#define BOARD_SOC_BCM2836   1
+#define BOARD_SOC_BCM2837   2
+#define BOARD_SOC_BCM2711   3
+#define BOARD_SOC_BCM2712   4
+#define BOARD_SOC_UNKNOWN   0xFF
+
+//  Pull up/down register schemes
+#define BOARD_PULL_GPPUD    0 // GPPUD / GPPUDCLK0 clocked sequence
+#define BOARD_PULL_DIRECT   1 // GPIO_PUP_PDN_CNTRL registers, 2 bits per GPI
+#define BOARD_PULL_PROBE    2 // Unknown SoC - detect scheme from registers
+
+#define BOARD_GPI_AVAILABLE 0x0FFFFFFC // GPI 2-27 are available on the 40-pin header of all models
+#define BOARD_MODEL_LEN     64 // Maximum length of model description including terminating null
+
+//  Structure describing the GPI capabilities of a SoC
+typedef struct board_caps_t {
+    const char* soc;        // SoC name
+    uint32_t available;     // Bitmask of GPI 0-31 available for use (bit 0 = GPI 0)
+    uint8_t fselRegs;       // Quantity of GPFSEL registers covering GPI 0-31, 10 GPI per register
+    uint8_t pullScheme;     // Pull up/down scheme [BOARD_PULL_GPPUD | BOARD_PULL_DIRECT | BOARD_PULL_PROBE]
+    uint8_t pullReg;        // Word offset of first pull register: GPPUD (GPPUDCLK0 follows) or GPPUPPDN0 for BOARD_PULL_DIRECT
+    uint8_t gpiomem;        // 1 if /dev/gpiomem exposes BCM2835 style GPI registers
+} board_caps_t;
+
+//  Structure describing the board
+typedef struct board_t {
+    char model[BOARD_MODEL_LEN];    // Model description, e.g. "Raspberry Pi 4 Model B Rev 1.4" or "Unknown"
+    uint32_t revision;              // Revision code or 0 if unknown
+    uint8_t soc;                    // SoC identifier [BOARD_SOC_BCM2835...BOARD_SOC_UNKNOWN]
+    uint8_t modelNumber;            // Model number [0 for Zero, 1..5 or 0xFF for unknown]
+    const board_caps_t* caps;       // Capabilities of SoC
+} board_t;
+
+/** @brief  Get board descriptor
+*   @retval board_t* Pointer to board descriptor, valid for lifetime of process
+*   @note   Board is probed on first call, subsequent calls return cached descriptor
+*/
+const board_t* getBoard();
+
+/** @brief  Get pull up/down register scheme, probing GPI registers if SoC is unknown
+*   @param  regs Pointer to memory mapped GPI registers
+*   @param  pullReg Pointer to receive word offset of first pull register
+*   @retval uint8_t Pull scheme [BOARD_PULL_GPPUD|BOARD_PULL_DIRECT]
+*/
+uint8_t getBoardPullScheme(volatile uint32_t* regs, uint8_t* pullReg);
+
+/** @brief  Check if GPI is available for use
+*   @param  gpi Raspberry Pi GPI pin number
+*   @retval uint8_t 1 if available
+*/
+static inline uint8_t isBoardGpiAvailable(uint32_t gpi) {
+    return gpi < 32 && (getBoard()->caps->available & (1UL << gpi));
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+//-----------------------------------------------------------------------------
+#endif // ZYNBOARD_H_INCLUDED
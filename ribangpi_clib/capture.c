@@ -0,0 +1,158 @@
+/*
+ * ******************************************************************
+ * ZYNTHIAN PROJECT: GPI Library
+ *
+ * Logic analyser capture of native Raspberry Pi GPI
+ *
+ * Copyright (C) 2021 Brian Walton <riban@zynthian.org>
+ *
+ * ******************************************************************
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * For a full copy of the GNU General Public License see the LICENSE.txt file.
+ *
+ * ******************************************************************
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE // Provides pthread_setaffinity_np
+#endif
+#include "capture.h"
+#include "rpigpi.h" // Provides GPI register map
+#include <fcntl.h> // Provides open
+#include <pthread.h> // Provides thread
+#include <sched.h> // Provides CPU affinity
+#include <sys/mman.h> // Provides mmap
+#include "timing.h" // Provides timestamps
+
+static pthread_t captureThread;
+static uint8_t capturing = 0; // 1 whilst capture thread exists
+static volatile uint8_t captureStop = 0; // 1 to request capture thread exit
+static capture_header_t* captureHeader = NULL; // Memory map of capture file
+static size_t captureSize = 0; // Size of capture file
+static uint32_t captureDuration = 0; // Duration of capture window in microseconds
+static int captureCpu = -1; // CPU core for capture thread
+
+/*  Define private functions */
+// Thread sampling GPI level register
+void* capture(void* arg) {
+    if(captureCpu >= 0) {
+        // Only raise priority when bound to a dedicated core, otherwise tight loop would starve other threads
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(captureCpu, &cpus);
+        if(pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) == 0) {
+            struct sched_param param = {sched_get_priority_max(SCHED_FIFO)};
+            pthread_setschedparam(pthread_self(), SCHED_FIFO, &param); // Best effort
+        }
+    }
+
+    volatile uint32_t* level = getRpiGpiMap() + BCM2835_GPLEV0;
+    capture_header_t* header = captureHeader;
+    capture_record_t* records = (capture_record_t*)(header + 1);
+    uint32_t mask = header->mask;
+    uint32_t capacity = header->capacity;
+    uint64_t head = 0, samples = 0;
+    capture_record_t* record = records;
+
+    uint64_t start = getCounterNs();
+    uint64_t end = start + (uint64_t)captureDuration * 1000;
+    uint64_t now = start;
+    header->startNs = start;
+    uint32_t last = *level & mask;
+    record->level = last;
+    record->run = 0;
+    record->timestamp = 0;
+    header->head = head = 1;
+
+    while(!captureStop) {
+        for(uint32_t i = 0; i < CAPTURE_CHECK_SAMPLES; ++i) {
+            uint32_t value = *level & mask;
+            if(value == last) {
+                ++record->run;
+                continue;
+            }
+            // Level changed - start new record
+            last = value;
+            record = &records[head % capacity];
+            record->level = value;
+            record->run = 1;
+            record->timestamp = getCounterNs() - start;
+            __atomic_store_n(&header->head, ++head, __ATOMIC_RELEASE);
+        }
+        samples += CAPTURE_CHECK_SAMPLES;
+        now = getCounterNs();
+        if(now >= end)
+            break;
+    }
+    header->samples = samples;
+    header->endNs = now;
+    __atomic_store_n(&header->complete, 1, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+int startCapture(const char* path, uint32_t mask, uint32_t durationUs, uint32_t capacity, int cpu) {
+    if(capturing || !getRpiGpiMap() || !path)
+        return -1;
+    if(!capacity)
+        capacity = CAPTURE_DEFAULT_RECORDS;
+    captureSize = sizeof(capture_header_t) + (size_t)capacity * sizeof(capture_record_t);
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0)
+        return -1;
+    if(ftruncate(fd, captureSize) < 0) {
+        close(fd);
+        return -1;
+    }
+    void* map = mmap(NULL, captureSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd); // Don't need the file open after memory map
+    if(map == MAP_FAILED)
+        return -1;
+    mlock(map, captureSize); // Best effort - avoid page faults during capture
+
+    captureHeader = (capture_header_t*)map;
+    captureHeader->magic = CAPTURE_MAGIC;
+    captureHeader->version = CAPTURE_VERSION;
+    captureHeader->mask = mask ? mask : CAPTURE_DEFAULT_MASK;
+    captureHeader->capacity = capacity;
+    captureDuration = durationUs;
+    captureCpu = cpu;
+    captureStop = 0;
+    if(pthread_create(&captureThread, NULL, capture, NULL)) {
+        munmap(map, captureSize);
+        captureHeader = NULL;
+        return -1;
+    }
+    capturing = 1;
+    return 0;
+}
+
+void stopCapture() {
+    captureStop = 1;
+}
+
+uint64_t waitCapture() {
+    if(!capturing)
+        return 0;
+    pthread_join(captureThread, NULL);
+    capturing = 0;
+    uint64_t samples = captureHeader->samples;
+    msync(captureHeader, captureSize, MS_SYNC);
+    munlock(captureHeader, captureSize);
+    munmap(captureHeader, captureSize);
+    captureHeader = NULL;
+    return samples;
+}
+
+uint8_t isCapturing() {
+    return capturing && !__atomic_load_n(&captureHeader->complete, __ATOMIC_ACQUIRE);
+}
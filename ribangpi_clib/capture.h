@@ -0,0 +1,99 @@
+/*
+ * ******************************************************************
+ * ZYNTHIAN PROJECT: GPI Library
+ *
+ * Logic analyser capture of native Raspberry Pi GPI
+ *
+ * Copyright (C) 2021 Brian Walton <riban@zynthian.org>
+ *
+ * ******************************************************************
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * For a full copy of the GNU General Public License see the LICENSE.txt file.
+ *
+ * ******************************************************************
+ */
+
+/*  Capture samples the GPI level register (GPLEV0) in a tight loop on a dedicated thread for a bounded window.
+    Only changes of the masked level are stored, run-length encoded with a timestamp, in a ring of records within a memory mapped file.
+    The file may be read whilst capture is in progress or analysed offline after capture completes.
+
+    File layout:
+        capture_header_t
+        capture_record_t[capacity]  Ring of records, record n is at index n % capacity
+
+    Each record describes a run of consecutive samples with the same level.
+    The run count of the newest record is updated in place until the level changes.
+    When the ring is full the oldest records are overwritten - header.head - header.capacity records have been lost.
+
+    The native GPI driver (addRpiGpiDevice) must be instantiated before starting capture.
+*/
+
+#ifndef ZYNCAPTURE_H_INCLUDED
+#define ZYNCAPTURE_H_INCLUDED
+
+#include "gpi.h"
+
+#define CAPTURE_MAGIC           0x43504752 // "RGPC" little endian
+#define CAPTURE_VERSION         1
+#define CAPTURE_DEFAULT_MASK    0x0FFFFFFF // GPI 0..27
+#define CAPTURE_DEFAULT_RECORDS 65536 // Default ring capacity (1MB file)
+#define CAPTURE_CHECK_SAMPLES   1024 // Quantity of samples between checks for end of capture window
+
+//  Structure describing header of capture file
+typedef struct capture_header_t {
+    uint32_t magic;         // CAPTURE_MAGIC
+    uint32_t version;       // CAPTURE_VERSION
+    uint32_t mask;          // Mask of sampled GPI
+    uint32_t capacity;      // Quantity of records in ring
+    uint64_t head;          // Quantity of records written
+    uint64_t samples;       // Quantity of samples taken
+    uint64_t startNs;       // Monotonic time of first sample in nanoseconds
+    uint64_t endNs;         // Monotonic time of last sample in nanoseconds
+    uint32_t complete;      // 1 when capture has finished
+    uint32_t reserved;
+} capture_header_t;
+
+//  Structure describing a run of samples with the same level
+typedef struct capture_record_t {
+    uint32_t level;         // Masked value of GPLEV0
+    uint32_t run;           // Quantity of consecutive samples at this level
+    uint64_t timestamp;     // Time of first sample at this level in nanoseconds since header.startNs
+} capture_record_t;
+
+/** @brief  Start capture on a dedicated thread
+*   @param  path Path of file to create for captured data
+*   @param  mask Bitmask of GPI to sample or 0 for CAPTURE_DEFAULT_MASK
+*   @param  durationUs Duration of capture window in microseconds
+*   @param  capacity Quantity of records in ring or 0 for CAPTURE_DEFAULT_RECORDS
+*   @param  cpu Index of CPU core dedicated to capture thread or -1 for no affinity
+*   @retval int 0 on success or -1 on failure, e.g. capture already running or native GPI driver not instantiated
+*   @note   When bound to a core the capture thread requests SCHED_FIFO, silently skipped if not permitted
+*/
+int startCapture(const char* path, uint32_t mask, uint32_t durationUs, uint32_t capacity, int cpu);
+
+/** @brief  Request capture to stop before end of window
+*/
+void stopCapture();
+
+/** @brief  Wait for capture to complete and close capture file
+*   @retval uint64_t Quantity of samples taken
+*/
+uint64_t waitCapture();
+
+/** @brief  Check if capture is in progress
+*   @retval uint8_t 1 if capturing
+*/
+uint8_t isCapturing();
+
+//-----------------------------------------------------------------------------
+#endif // ZYNCAPTURE_H_INCLUDED
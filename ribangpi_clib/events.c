@@ -0,0 +1,241 @@
+/*
+ * ******************************************************************
+ * ZYNTHIAN PROJECT: GPI Library
+ *
+ * Batch retrieval of GPI events
+ *
+ * Copyright (C) 2021 Brian Walton <riban@zynthian.org>
+ *
+ * ******************************************************************
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * For a full copy of the GNU General Public License see the LICENSE.txt file.
+ *
+ * ******************************************************************
+ */
+
+#include "events.h"
+#include "stats.h" // Provides instrumentation
+#include "timing.h" // Provides timestamps
+#include <pthread.h> // Provides mutex, condition
+#include <string.h> // Provides memcpy, memset
+
+static pthread_mutex_t eventMutex = PTHREAD_MUTEX_INITIALIZER; // Protects event queue
+static pthread_cond_t eventCond; // Signals waiting consumer when event queued
+static pthread_once_t eventOnce = PTHREAD_ONCE_INIT;
+static gpi_event_t eventQueue[GPI_EVENT_QUEUE_SIZE];
+static uint32_t eventHead = 0; // Index of next event to write (free running)
+static uint32_t eventTail = 0; // Index of next event to read (free running)
+static uint32_t eventChanged[GPI_EVENT_BITMAP_WORDS]; // Bitmap of GPI changed since last retrieval
+static uint8_t eventsEnabled = 0; // 1 to queue events
+static uint32_t eventWaiters = 0; // Quantity of consumers blocked in waitGpiEvents
+static uint32_t eventHeld = 0; // Quantity of GPI with an event held by rate limiting
+
+//  Structure describing delivery policy and coalescing state of events from a GPI
+typedef struct event_policy_t {
+    uint8_t policy;         // Delivery policy [GPI_EVENT_POLICY_EDGE|GPI_EVENT_POLICY_LATEST|GPI_EVENT_POLICY_RATE]
+    uint8_t held;           // 1 if an event is held awaiting end of rate limiting interval
+    uint32_t interval;      // Minimum time between events in microseconds
+    uint32_t position;      // Queue position of last queued event (free running)
+    uint64_t last;          // Time of last queued event in nanoseconds
+    gpi_event_t event;      // Held event
+} event_policy_t;
+
+static event_policy_t eventPolicies[MAX_GPI];
+
+/*  Define private functions */
+static void initEvents() {
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&eventCond, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+// Copy events and bitmap to caller buffers - call with eventMutex locked
+static uint32_t takeEvents(uint32_t* changed, gpi_event_t* events, uint32_t max) {
+    if(changed) {
+        memcpy(changed, eventChanged, sizeof(eventChanged));
+        memset(eventChanged, 0, sizeof(eventChanged));
+    }
+    if(!events)
+        return 0;
+    uint32_t count = eventHead - eventTail;
+    if(count > max)
+        count = max;
+    // Copy in up to two contiguous blocks
+    uint32_t start = eventTail & (GPI_EVENT_QUEUE_SIZE - 1);
+    uint32_t first = GPI_EVENT_QUEUE_SIZE - start;
+    if(first > count)
+        first = count;
+    memcpy(events, &eventQueue[start], first * sizeof(gpi_event_t));
+    memcpy(events + first, eventQueue, (count - first) * sizeof(gpi_event_t));
+    eventTail += count;
+    return count;
+}
+
+// Add event to queue, returning its position - call with eventMutex locked
+static uint32_t pushEvent(const gpi_event_t* event) {
+    uint8_t overflow = 0;
+    if(eventHead - eventTail >= GPI_EVENT_QUEUE_SIZE) {
+        ++eventTail; // Discard oldest event
+        overflow = 1;
+    }
+    uint32_t position = eventHead++;
+    eventQueue[position & (GPI_EVENT_QUEUE_SIZE - 1)] = *event;
+    statsRecordEventQueue(eventHead - eventTail, overflow);
+    if(eventWaiters)
+        pthread_cond_signal(&eventCond);
+    return position;
+}
+
+// Check if event at queue position has not yet been retrieved or discarded - call with eventMutex locked
+static uint8_t isEventQueued(uint32_t position) {
+    return position - eventTail < eventHead - eventTail;
+}
+
+// Merge newer event into coalesced event: change events count transitions, other types take latest data
+static void mergeEvent(gpi_event_t* target, const gpi_event_t* event) {
+    int32_t data = target->type == GPI_EVENT_CHANGE ? target->data + event->data : event->data;
+    *target = *event;
+    target->data = data;
+    statsRecordEventCoalesced();
+}
+
+// Queue held event - call with eventMutex locked
+static void releaseEvent(event_policy_t* policy) {
+    policy->position = pushEvent(&policy->event);
+    policy->last = policy->event.timestamp;
+    policy->held = 0;
+    --eventHeld;
+}
+
+void enableGpiEvents(uint8_t enable) {
+    pthread_once(&eventOnce, initEvents);
+    pthread_mutex_lock(&eventMutex);
+    eventHead = eventTail = 0;
+    memset(eventChanged, 0, sizeof(eventChanged));
+    for(uint32_t gpi = 0; gpi < MAX_GPI; ++gpi) {
+        eventPolicies[gpi].held = 0;
+        eventPolicies[gpi].last = 0;
+    }
+    eventHeld = 0;
+    eventsEnabled = enable ? 1 : 0;
+    pthread_mutex_unlock(&eventMutex);
+}
+
+uint32_t getGpiEvents(uint32_t* changed, gpi_event_t* events, uint32_t max) {
+    pthread_mutex_lock(&eventMutex);
+    uint32_t count = takeEvents(changed, events, max);
+    pthread_mutex_unlock(&eventMutex);
+    return count;
+}
+
+uint32_t waitGpiEvents(uint32_t* changed, gpi_event_t* events, uint32_t max, uint32_t timeout) {
+    pthread_once(&eventOnce, initEvents);
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += timeout / 1000;
+    deadline.tv_nsec += (timeout % 1000) * 1000000;
+    if(deadline.tv_nsec >= 1000000000) {
+        ++deadline.tv_sec;
+        deadline.tv_nsec -= 1000000000;
+    }
+    pthread_mutex_lock(&eventMutex);
+    ++eventWaiters;
+    while(eventHead == eventTail) {
+        int err = timeout ? pthread_cond_timedwait(&eventCond, &eventMutex, &deadline) : pthread_cond_wait(&eventCond, &eventMutex);
+        if(err)
+            break; // Timeout
+    }
+    --eventWaiters;
+    uint32_t count = takeEvents(changed, events, max);
+    pthread_mutex_unlock(&eventMutex);
+    return count;
+}
+
+uint32_t getGpiEventCount() {
+    pthread_mutex_lock(&eventMutex);
+    uint32_t count = eventHead - eventTail;
+    pthread_mutex_unlock(&eventMutex);
+    return count;
+}
+
+int setGpiEventPolicy(uint32_t gpi, uint8_t policy, uint32_t interval) {
+    if(gpi >= MAX_GPI || policy > GPI_EVENT_POLICY_RATE)
+        return -1;
+    pthread_mutex_lock(&eventMutex);
+    if(eventPolicies[gpi].held)
+        releaseEvent(&eventPolicies[gpi]);
+    eventPolicies[gpi].policy = policy;
+    eventPolicies[gpi].interval = interval;
+    pthread_mutex_unlock(&eventMutex);
+    return 0;
+}
+
+uint8_t getGpiEventPolicy(uint32_t gpi) {
+    if(gpi >= MAX_GPI)
+        return GPI_EVENT_POLICY_EDGE;
+    return __atomic_load_n(&eventPolicies[gpi].policy, __ATOMIC_RELAXED);
+}
+
+void releaseGpiEvents() {
+    if(!__atomic_load_n(&eventHeld, __ATOMIC_RELAXED))
+        return;
+    uint64_t now = getCounterNs();
+    pthread_mutex_lock(&eventMutex);
+    for(uint32_t gpi = 0; gpi < MAX_GPI && eventHeld; ++gpi) {
+        event_policy_t* policy = &eventPolicies[gpi];
+        if(policy->held && now - policy->last >= policy->interval * 1000ULL)
+            releaseEvent(policy);
+    }
+    pthread_mutex_unlock(&eventMutex);
+}
+
+void queueGpiEvent(uint32_t gpi, uint8_t type, uint8_t value, int32_t data) {
+    if(!__atomic_load_n(&eventsEnabled, __ATOMIC_RELAXED) || gpi >= MAX_GPI)
+        return;
+    gpi_event_t event = {gpi, type, value, data, getCounterNs()};
+    pthread_mutex_lock(&eventMutex);
+    eventChanged[gpi / 32] |= 1UL << (gpi % 32);
+    event_policy_t* policy = &eventPolicies[gpi];
+    // Gesture events are discrete so are never coalesced with each other or with value events
+    switch(type < GPI_EVENT_PRESS ? policy->policy : GPI_EVENT_POLICY_EDGE) {
+        case GPI_EVENT_POLICY_LATEST:
+            if(isEventQueued(policy->position)) {
+                gpi_event_t* queued = &eventQueue[policy->position & (GPI_EVENT_QUEUE_SIZE - 1)];
+                if(queued->gpi == gpi && queued->type == type) {
+                    mergeEvent(queued, &event);
+                    break;
+                }
+            }
+            policy->position = pushEvent(&event);
+            break;
+        case GPI_EVENT_POLICY_RATE:
+            if(policy->held && policy->event.type == type) {
+                mergeEvent(&policy->event, &event);
+            } else if(policy->held) {
+                pushEvent(&event); // Held slot holds another value type, e.g. analog and change on same GPI
+            } else if(policy->last && event.timestamp - policy->last < policy->interval * 1000ULL) {
+                policy->event = event;
+                policy->held = 1;
+                ++eventHeld;
+            } else {
+                policy->position = pushEvent(&event);
+                policy->last = event.timestamp;
+            }
+            break;
+        default:
+            pushEvent(&event);
+    }
+    pthread_mutex_unlock(&eventMutex);
+}
@@ -0,0 +1,139 @@
+/*
+ * ******************************************************************
+ * ZYNTHIAN PROJECT: GPI Library
+ *
+ * Batch retrieval of GPI events
+ *
+ * Copyright (C) 2021 Brian Walton <riban@zynthian.org>
+ *
+ * ******************************************************************
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * For a full copy of the GNU General Public License see the LICENSE.txt file.
+ *
+ * ******************************************************************
+ */
+
+/*  Events are queued by notifyGpiChange (and other event sources) into a fixed size ring and retrieved in batches by a single
+    call, avoiding a foreign function call per GPI for consumers such as Python via ctypes.
+    Records have a stable, naturally aligned 16 byte layout which numpy may view without copying:
+        dtype = numpy.dtype([('gpi', '<u2'), ('type', 'u1'), ('value', 'u1'), ('data', '<i4'), ('timestamp', '<u8')])
+        events = numpy.zeros(256, dtype)
+        changed = numpy.zeros(GPI_EVENT_BITMAP_WORDS, numpy.uint32)
+        count = lib.waitGpiEvents(changed.ctypes.data, events.ctypes.data, len(events), 20)
+        for gpi, type, value, data, timestamp in events[:count]: ...
+    When the queue is full the oldest event is discarded and counted in stats eventOverflow. The changed bitmap still reports
+    every GPI that changed so consumers may re-read state after overflow.
+    Each GPI has a delivery policy limiting the events it queues, e.g. for a chattering contact or fast encoder:
+        GPI_EVENT_POLICY_EDGE: every event is queued (default)
+        GPI_EVENT_POLICY_LATEST: at most one event is queued, updated in place with the latest value until retrieved
+        GPI_EVENT_POLICY_RATE: at most one event is queued per interval, later events are held and the latest is queued by
+            the poll thread when the interval expires
+    Coalesced change events carry the quantity of transitions they represent in data. Only events of the same type are
+    coalesced and gesture events (GPI_EVENT_PRESS..GPI_EVENT_REPEAT) are always queued. Policies apply only to the event
+    queue - change callback and MIDI bridge still see every change.
+*/
+
+#ifndef ZYNGPIEVENTS_H_INCLUDED
+#define ZYNGPIEVENTS_H_INCLUDED
+
+#include "gpi.h"
+
+#define GPI_EVENT_QUEUE_SIZE    1024 // Maximum quantity of queued events (power of 2)
+#define GPI_EVENT_BITMAP_WORDS  (MAX_GPI / 32) // Quantity of 32-bit words in changed bitmap
+
+/*  Event types */
+#define GPI_EVENT_CHANGE        0 // Value of GPI changed, data: quantity of transitions represented by event
+#define GPI_EVENT_ANALOG        1 // Analog value changed by at least hysteresis, data: value, value unused
+#define GPI_EVENT_PRESS         2 // Gesture: GPI became active, data unused
+#define GPI_EVENT_RELEASE       3 // Gesture: GPI became inactive, data: press duration in milliseconds
+#define GPI_EVENT_LONG_PRESS    4 // Gesture: GPI held for long press time, data: press duration in milliseconds
+#define GPI_EVENT_DOUBLE_CLICK  5 // Gesture: second press within double click time, data: quantity of clicks
+#define GPI_EVENT_REPEAT        6 // Gesture: GPI held for auto-repeat, data: quantity of repeats
+
+/*  Event delivery policies */
+#define GPI_EVENT_POLICY_EDGE   0 // Queue every event
+#define GPI_EVENT_POLICY_LATEST 1 // Queue latest value only, coalesced until consumer retrieves event
+#define GPI_EVENT_POLICY_RATE   2 // Queue at most one event per interval with count of transitions
+
+//  Structure describing an event - layout is part of the ABI and must not change
+typedef struct __attribute__((packed, aligned(8))) gpi_event_t {
+    uint16_t gpi;           // Index of GPI within global gpimap
+    uint8_t type;           // Event type [GPI_EVENT_CHANGE..GPI_EVENT_REPEAT]
+    uint8_t value;          // GPI value
+    int32_t data;           // Event type specific data
+    uint64_t timestamp;     // Time of event in nanoseconds (getCounterNs timebase)
+} gpi_event_t;
+
+_Static_assert(sizeof(gpi_event_t) == 16, "gpi_event_t layout changed");
+
+/** @brief  Enable / disable queuing of events
+*   @param  enable 1 to enable, 0 to disable
+*   @note   Disabled by default. Enabling clears queue and changed bitmap.
+*/
+void enableGpiEvents(uint8_t enable);
+
+/** @brief  Retrieve queued events without blocking
+*   @param  changed Pointer to bitmap of GPI_EVENT_BITMAP_WORDS words to populate with GPI that changed since last retrieval
+*           (bit n of word n / 32 represents GPI n) or NULL if not required
+*   @param  events Pointer to array to populate with events, oldest first, or NULL if not required
+*   @param  max Quantity of records events may hold
+*   @retval uint32_t Quantity of events written to events
+*   @note   Events beyond max remain queued but changed bitmap is cleared
+*/
+uint32_t getGpiEvents(uint32_t* changed, gpi_event_t* events, uint32_t max);
+
+/** @brief  Retrieve queued events, blocking until at least one event is queued
+*   @param  changed Pointer to bitmap to populate with GPI that changed since last retrieval or NULL if not required
+*   @param  events Pointer to array to populate with events, oldest first, or NULL if not required
+*   @param  max Quantity of records events may hold
+*   @param  timeout Maximum time to wait in milliseconds, 0 to wait indefinitely
+*   @retval uint32_t Quantity of events written to events, 0 on timeout
+*/
+uint32_t waitGpiEvents(uint32_t* changed, gpi_event_t* events, uint32_t max, uint32_t timeout);
+
+/** @brief  Get quantity of queued events
+*   @retval uint32_t Quantity of events waiting to be retrieved
+*/
+uint32_t getGpiEventCount();
+
+/** @brief  Set delivery policy of events from a GPI
+*   @param  gpi Index of GPI within global gpimap
+*   @param  policy Delivery policy [GPI_EVENT_POLICY_EDGE|GPI_EVENT_POLICY_LATEST|GPI_EVENT_POLICY_RATE]
+*   @param  interval Minimum time between events in microseconds (GPI_EVENT_POLICY_RATE only)
+*   @retval int 0 on success, -1 on invalid parameter
+*   @note   Any event held by previous policy is queued immediately
+*/
+int setGpiEventPolicy(uint32_t gpi, uint8_t policy, uint32_t interval);
+
+/** @brief  Get delivery policy of events from a GPI
+*   @param  gpi Index of GPI within global gpimap
+*   @retval uint8_t Delivery policy, GPI_EVENT_POLICY_EDGE for invalid GPI
+*/
+uint8_t getGpiEventPolicy(uint32_t gpi);
+
+/** @brief  Queue held events whose rate limiting interval has expired
+*   @note   Called by poll thread each cycle
+*/
+void releaseGpiEvents();
+
+/** @brief  Add an event to queue
+*   @param  gpi Index of GPI within global gpimap
+*   @param  type Event type
+*   @param  value GPI value
+*   @param  data Event type specific data
+*   @note   Called by notifyGpiChange and other event sources. Ignored if events not enabled. Subject to GPI delivery policy.
+*/
+void queueGpiEvent(uint32_t gpi, uint8_t type, uint8_t value, int32_t data);
+
+//-----------------------------------------------------------------------------
+#endif // ZYNGPIEVENTS_H_INCLUDED
@@ -0,0 +1,494 @@
+/*
+ * ******************************************************************
+ * ZYNTHIAN PROJECT: GPI Library
+ *
+ * Library for interfacing I2C GPI expanders with Zynthian
+ *
+ * Copyright (C) 2021 Brian Walton <riban@zynthian.org>
+ *
+ * ******************************************************************
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * For a full copy of the GNU General Public License see the LICENSE.txt file.
+ *
+ * ******************************************************************
+ */
+
+#include "expandergpi.h"
+#include "mcp23017gpi.h" // Provides MCP23017 register definitions
+#include "i2c.h" // Provides I2C interface
+#include "spi.h" // Provides SPI interface
+#include <string.h> // Provides memcpy
+
+#define MCP23017_BANK0(reg, port) ((reg) * 2 + (port)) // Address of MCP23017 register when IOCON.BANK=0
+#define MCP23017_IOCON          0x40 // IOCON: BANK=0, MIRROR=1 (single interrupt output), SEQOP=0 (sequential access)
+#define MCP23008_IOCON          0x00 // IOCON: SEQOP=0 (sequential access)
+#define MCP23S17_IOCON          0x48 // IOCON: BANK=0, MIRROR=1, SEQOP=0, HAEN=1 (hardware address pins enabled)
+#define MCP23S17_OPCODE         0x40 // SPI control byte: 0100 A2 A1 A0 R/W
+#define MCP23S17_MAX_BURST      16 // Maximum quantity of registers transferred by SPI bus access
+
+//  Structure describing expander GPI driver config
+typedef struct expandergpidata_t {
+    const expander_desc_t* desc; // Device descriptor
+    uint8_t address;    // Bus address
+    uint8_t interrupt;  // GPI pin of interrupt
+    i2c_health_t health; // Health of device
+    uint8_t dir[EXPANDER_MAX_PORTS]; // Shadow of direction registers (bit set: input) used to restore device after failure
+    uint8_t pull[EXPANDER_MAX_PORTS]; // Shadow of pull-up registers
+    uint8_t olat[EXPANDER_MAX_PORTS]; // Shadow of output latches
+    uint8_t dirty;      // Bitmap of ports with output latch changes pending write-behind
+} expandergpidata_t;
+
+/*  Private helper functions */
+expandergpidata_t* getExpanderConfig(uint32_t driver); // Get a pointer to the driver's config data or NULL for invalid driver
+void initExpander(expandergpidata_t* config); // Configure device and restore registers from shadow
+
+int expanderI2cRead(uint8_t address, uint8_t reg, uint8_t* buffer, uint8_t len) {
+    if(reg == EXPANDER_REG_NONE)
+        return i2cRead(address, buffer, len);
+    return i2cReadRegisters(address, reg, buffer, len);
+}
+
+int expanderI2cWrite(uint8_t address, uint8_t reg, const uint8_t* buffer, uint8_t len) {
+    if(reg == EXPANDER_REG_NONE)
+        return i2cWrite(address, buffer, len);
+    return i2cWriteRegisters(address, reg, buffer, len);
+}
+
+int expanderI2cOpen(uint8_t address) {
+    return i2cOpen();
+}
+
+const expander_bus_t expanderI2cBus = {expanderI2cOpen, expanderI2cRead, expanderI2cWrite};
+
+int expanderSpiOpen(uint8_t address) {
+    return spiOpen(address >> 3);
+}
+
+// Read registers in one full-duplex transfer: opcode and register are clocked out whilst data is clocked in after them
+int expanderSpiRead(uint8_t address, uint8_t reg, uint8_t* buffer, uint8_t len) {
+    if(reg == EXPANDER_REG_NONE || len > MCP23S17_MAX_BURST)
+        return -1;
+    uint8_t tx[MCP23S17_MAX_BURST + 2] = {MCP23S17_OPCODE | (address & 0x07) << 1 | 1, reg};
+    uint8_t rx[MCP23S17_MAX_BURST + 2];
+    int result = spiTransfer(address >> 3, tx, rx, len + 2);
+    if(result == 0)
+        memcpy(buffer, rx + 2, len);
+    return result;
+}
+
+int expanderSpiWrite(uint8_t address, uint8_t reg, const uint8_t* buffer, uint8_t len) {
+    if(reg == EXPANDER_REG_NONE || len > MCP23S17_MAX_BURST)
+        return -1;
+    uint8_t tx[MCP23S17_MAX_BURST + 2] = {MCP23S17_OPCODE | (address & 0x07) << 1, reg};
+    memcpy(tx + 2, buffer, len);
+    return spiTransfer(address >> 3, tx, NULL, len + 2);
+}
+
+const expander_bus_t expanderSpiBus = {expanderSpiOpen, expanderSpiRead, expanderSpiWrite};
+
+const expander_desc_t expanderMcp23008 = {
+    GPI_DRIVER_MCP23008, 1, 0x20, 0x27,
+    MCP23017_REG_GPIO, MCP23017_REG_OLAT, MCP23017_REG_IODIR, MCP23017_REG_GPPU, MCP23017_REG_IPOL, MCP23017_REG_GPINTEN,
+    MCP23017_REG_IOCON, EXPANDER_REG_NONE, MCP23008_IOCON,
+    &expanderI2cBus
+};
+
+const expander_desc_t expanderMcp23017 = {
+    GPI_DRIVER_MCP23017, 2, 0x20, 0x27,
+    MCP23017_BANK0(MCP23017_REG_GPIO, 0), MCP23017_BANK0(MCP23017_REG_OLAT, 0), MCP23017_BANK0(MCP23017_REG_IODIR, 0),
+    MCP23017_BANK0(MCP23017_REG_GPPU, 0), MCP23017_BANK0(MCP23017_REG_IPOL, 0), MCP23017_BANK0(MCP23017_REG_GPINTEN, 0),
+    MCP23017_REG_IOCON_BANK0, MCP23017_REG_IOCON, MCP23017_IOCON, // IOCON is at 0x05 if device was left with BANK=1
+    &expanderI2cBus
+};
+
+const expander_desc_t expanderMcp23S17 = {
+    GPI_DRIVER_MCP23S17, 2, EXPANDER_SPI_ADDRESS(0, 0), EXPANDER_SPI_ADDRESS(SPI_MAX_CS - 1, 7),
+    MCP23017_BANK0(MCP23017_REG_GPIO, 0), MCP23017_BANK0(MCP23017_REG_OLAT, 0), MCP23017_BANK0(MCP23017_REG_IODIR, 0),
+    MCP23017_BANK0(MCP23017_REG_GPPU, 0), MCP23017_BANK0(MCP23017_REG_IPOL, 0), MCP23017_BANK0(MCP23017_REG_GPINTEN, 0),
+    MCP23017_REG_IOCON_BANK0, MCP23017_REG_IOCON, MCP23S17_IOCON, // Until HAEN is set every device on the chip select accepts the write
+    &expanderSpiBus
+};
+
+const expander_desc_t expanderPca9555 = {
+    GPI_DRIVER_PCA9555, 2, 0x20, 0x27,
+    0x00, 0x02, 0x06, EXPANDER_REG_NONE, 0x04, EXPANDER_REG_NONE,
+    EXPANDER_REG_NONE, EXPANDER_REG_NONE, 0,
+    &expanderI2cBus
+};
+
+const expander_desc_t expanderPcf8574 = {
+    GPI_DRIVER_PCF8574, 1, 0x20, 0x3F,
+    EXPANDER_REG_NONE, EXPANDER_REG_NONE, EXPANDER_REG_NONE, EXPANDER_REG_NONE, EXPANDER_REG_NONE, EXPANDER_REG_NONE,
+    EXPANDER_REG_NONE, EXPANDER_REG_NONE, 0,
+    &expanderI2cBus
+};
+
+// Read quantity of consecutive registers, returning 0 on success or -1 on failure or if device access is suspended
+int readExpanderPorts(expandergpidata_t* config, uint8_t reg, uint8_t* buffer, uint8_t count) {
+    if(!i2cHealthReady(&config->health))
+        return -1;
+    int result = config->desc->bus->read(config->address, reg, buffer, count);
+    if(i2cHealthUpdate(&config->health, result))
+        initExpander(config);
+    return result < 0 ? -1 : 0;
+}
+
+// Write registers, returning 0 on success or -1 on failure or if device access is suspended
+int writeExpanderRegisters(expandergpidata_t* config, uint8_t reg, const uint8_t* buffer, uint8_t len) {
+    if(!i2cHealthReady(&config->health))
+        return -1;
+    int result = config->desc->bus->write(config->address, reg, buffer, len);
+    if(i2cHealthUpdate(&config->health, result))
+        initExpander(config);
+    return result < 0 ? -1 : 0;
+}
+
+// Write output latch of a port or all ports of device without registers
+int writeExpanderOutput(expandergpidata_t* config, uint8_t port) {
+    const expander_desc_t* desc = config->desc;
+    if(desc->regOutput != EXPANDER_REG_NONE)
+        return writeExpanderRegisters(config, desc->regOutput + port, &config->olat[port], 1);
+    // Quasi-bidirectional: inputs are written high so that they are weakly pulled up and may be driven low externally
+    uint8_t values[EXPANDER_MAX_PORTS];
+    for(uint8_t i = 0; i < desc->ports; ++i)
+        values[i] = config->olat[i] | config->dir[i];
+    return writeExpanderRegisters(config, EXPANDER_REG_NONE, values, desc->ports);
+}
+
+// Read registers then write span of those that differ from desired values in one burst, returning quantity of registers written or -1 on failure
+int syncExpanderRegisters(expandergpidata_t* config, uint8_t reg, const uint8_t* values, uint8_t count) {
+    if(reg == EXPANDER_REG_NONE)
+        return 0;
+    uint8_t current[EXPANDER_MAX_PORTS];
+    if(readExpanderPorts(config, reg, current, count) < 0)
+        return -1;
+    uint32_t differ = 0;
+    for(uint8_t i = 0; i < count; ++i)
+        if(current[i] != values[i])
+            differ |= 1 << i;
+    if(!differ)
+        return 0;
+    uint8_t first = __builtin_ctz(differ);
+    uint8_t last = 31 - __builtin_clz(differ);
+    if(writeExpanderRegisters(config, reg + first, values + first, last - first + 1) < 0)
+        return -1;
+    return last - first + 1;
+}
+
+// Get interrupt enable register values so that interrupt signals change of any input
+void getExpanderIntEnable(expandergpidata_t* config, uint8_t* values) {
+    for(uint8_t port = 0; port < config->desc->ports; ++port)
+        values[port] = config->interrupt ? config->dir[port] : 0;
+}
+
+// Write interrupt enable registers so that interrupt signals change of any input
+void writeExpanderIntEnable(expandergpidata_t* config) {
+    const expander_desc_t* desc = config->desc;
+    if(desc->regIntEnable == EXPANDER_REG_NONE)
+        return;
+    uint8_t values[EXPANDER_MAX_PORTS];
+    getExpanderIntEnable(config, values);
+    writeExpanderRegisters(config, desc->regIntEnable, values, desc->ports);
+}
+
+/*  Adopt configuration left in device, e.g. by a previous process, so that adding driver does not disturb pins.
+    Returns 0 on success or -1 if device must be initialised, i.e. not configured as required or state cannot be read.
+*/
+int adoptExpander(expandergpidata_t* config) {
+    const expander_desc_t* desc = config->desc;
+    if(desc->regDirection == EXPANDER_REG_NONE)
+        return -1; // Quasi-bidirectional output latch cannot be read back
+    uint8_t value;
+    if(desc->regConfig != EXPANDER_REG_NONE && (readExpanderPorts(config, desc->regConfig, &value, 1) < 0 || value != desc->configValue))
+        return -1;
+    uint8_t olat[EXPANDER_MAX_PORTS], dir[EXPANDER_MAX_PORTS], pull[EXPANDER_MAX_PORTS] = {0};
+    if(readExpanderPorts(config, desc->regOutput, olat, desc->ports) < 0 || readExpanderPorts(config, desc->regDirection, dir, desc->ports) < 0)
+        return -1;
+    if(desc->regPull != EXPANDER_REG_NONE && readExpanderPorts(config, desc->regPull, pull, desc->ports) < 0)
+        return -1;
+    memcpy(config->olat, olat, desc->ports);
+    memcpy(config->dir, dir, desc->ports);
+    memcpy(config->pull, pull, desc->ports);
+    // Polarity inversion and interrupt enable are owned by driver
+    uint8_t values[EXPANDER_MAX_PORTS] = {0};
+    syncExpanderRegisters(config, desc->regPolarity, values, desc->ports);
+    getExpanderIntEnable(config, values);
+    syncExpanderRegisters(config, desc->regIntEnable, values, desc->ports);
+    return 0;
+}
+
+void initExpander(expandergpidata_t* config) {
+    const expander_desc_t* desc = config->desc;
+    /*  Device may have been power cycled or left in a different configuration so write configuration register at its
+        alternative address first. Any other register hit by this write is restored below.
+    */
+    if(desc->regConfigAlt != EXPANDER_REG_NONE)
+        writeExpanderRegisters(config, desc->regConfigAlt, &desc->configValue, 1);
+    if(desc->regConfig != EXPANDER_REG_NONE)
+        writeExpanderRegisters(config, desc->regConfig, &desc->configValue, 1);
+    if(desc->regPolarity != EXPANDER_REG_NONE) {
+        uint8_t values[EXPANDER_MAX_PORTS] = {0};
+        writeExpanderRegisters(config, desc->regPolarity, values, desc->ports);
+    }
+    // Restore shadows with one burst per register set - output latch before direction to avoid glitches
+    if(desc->regOutput != EXPANDER_REG_NONE)
+        writeExpanderRegisters(config, desc->regOutput, config->olat, desc->ports);
+    else
+        writeExpanderOutput(config, 0);
+    if(desc->regPull != EXPANDER_REG_NONE)
+        writeExpanderRegisters(config, desc->regPull, config->pull, desc->ports);
+    writeExpanderIntEnable(config);
+    if(desc->regDirection != EXPANDER_REG_NONE)
+        writeExpanderRegisters(config, desc->regDirection, config->dir, desc->ports);
+}
+
+int addExpanderGpiDevice(const expander_desc_t* desc, uint8_t address, uint8_t interrupt) {
+    if(!desc || desc->ports < 1 || desc->ports > EXPANDER_MAX_PORTS || address < desc->addressMin || address > desc->addressMax)
+        return -1;
+    lockGpiDrivers();
+    uint8_t driverCount;
+    for(driverCount = 0; driverCount < MAX_GPI_DRIVERS; ++driverCount) {
+        if(gpiDrivers[driverCount].type == GPI_DRIVER_NONE)
+            break;
+        expandergpidata_t* existing = getExpanderConfig(driverCount);
+        if(existing && existing->desc->bus == desc->bus && existing->address == address) {
+            unlockGpiDrivers();
+            return existing->desc == desc ? driverCount : -1; // Address already used by another device type
+        }
+    }
+    if(driverCount >= MAX_GPI_DRIVERS || zynGpiCount + desc->ports * 8 > MAX_GPI || desc->bus->open(address) < 0) {
+        unlockGpiDrivers();
+        return -1;
+    }
+
+    gpi_driver_t* driver = &gpiDrivers[driverCount];
+    driver->type = desc->type;
+    driver->size = desc->ports * 8; // Device specific size
+    driver->offset = zynGpiCount;
+    driver->config = (uint8_t*)malloc(sizeof(expandergpidata_t));
+    expandergpidata_t* config = (expandergpidata_t*)driver->config;
+    config->desc = desc;
+    config->address = address;
+    config->interrupt = interrupt;
+    i2cHealthReset(&config->health);
+    for(uint8_t port = 0; port < EXPANDER_MAX_PORTS; ++port) {
+        config->dir[port] = 0xFF; // Power on default: all inputs
+        config->pull[port] = 0;
+        config->olat[port] = 0;
+    }
+    config->dirty = 0;
+    // Configure device unless already configured - if device does not respond it will be re-probed and configured by poll
+    if(adoptExpander(config) < 0)
+        initExpander(config);
+    driver->setState = setExpanderGpiState;
+    driver->setDirection = setExpanderGpiDirection;
+    driver->setPull = setExpanderGpiPull;
+    driver->getStatus = getExpanderGpiStatus;
+    driver->flush = flushExpanderGpi;
+    driver->configure = configureExpanderGpi;
+    driver->gpis = (gpi_t*) malloc (driver->size * sizeof(gpi_t));
+    for(int i  = 0; i < driver->size; ++i) {
+        (driver->gpis[i]).dir = !bitRead(config->dir[i / 8], i % 8); // Matches direction shadow
+        (driver->gpis[i]).value = (driver->gpis[i]).dir == OUTPUT ? bitRead(config->olat[i / 8], i % 8) : 0;
+        (driver->gpis[i]).enabled = 0;
+        (driver->gpis[i]).rateClass = GPI_RATE_DEFAULT;
+        gpimap[zynGpiCount].driver = driverCount;
+        gpimap[zynGpiCount++].offset = i;
+    }
+    driver->poll = pollExpanderGpi; // Assign last so that poll thread does not see partially populated driver
+    unlockGpiDrivers();
+    updatePolling();
+    return driverCount;
+}
+
+int addMcp23008GpiDevice(uint8_t address) {
+    return addExpanderGpiDevice(&expanderMcp23008, address, 0);
+}
+
+int addMcp23017GpiDevice(uint8_t address, uint8_t interrupt) {
+    return addExpanderGpiDevice(&expanderMcp23017, address, interrupt);
+}
+
+int addMcp23S17GpiDevice(uint8_t cs, uint8_t address, uint8_t interrupt) {
+    if(cs >= SPI_MAX_CS || address > 7)
+        return -1;
+    return addExpanderGpiDevice(&expanderMcp23S17, EXPANDER_SPI_ADDRESS(cs, address), interrupt);
+}
+
+int addPca9555GpiDevice(uint8_t address) {
+    return addExpanderGpiDevice(&expanderPca9555, address, 0);
+}
+
+int addPcf8574GpiDevice(uint8_t address) {
+    return addExpanderGpiDevice(&expanderPcf8574, address, 0);
+}
+
+expandergpidata_t* getExpanderConfig(uint32_t driver) {
+    if(driver >= MAX_GPI_DRIVERS || gpiDrivers[driver].getStatus != getExpanderGpiStatus)
+        return NULL;
+    return (expandergpidata_t*)gpiDrivers[driver].config;
+}
+
+void setExpanderGpiState(uint32_t gpi, uint8_t state) {
+    //!@todo Validate GPI enabled and direction=output
+    uint32_t offset = gpimap[gpi].offset;
+    expandergpidata_t* config = getExpanderConfig(gpimap[gpi].driver);
+    if(!config)
+        return;
+    uint8_t port = offset / 8;
+    uint8_t bit = 1 << (offset % 8);
+    // Modify shadow rather than reading device which may be unavailable
+    if(state)
+        config->olat[port] |= bit;
+    else
+        config->olat[port] &= ~bit;
+    getGpi(gpi).value = state?1:0;
+    if(getGpiWriteBehind())
+        config->dirty |= 1 << port;
+    else
+        writeExpanderOutput(config, port);
+}
+
+void flushExpanderGpi(uint32_t driver) {
+    expandergpidata_t* config = getExpanderConfig(driver);
+    if(!config)
+        return;
+    uint8_t dirty = config->dirty;
+    if(!dirty)
+        return;
+    config->dirty = 0;
+    const expander_desc_t* desc = config->desc;
+    if(desc->regOutput == EXPANDER_REG_NONE) {
+        writeExpanderOutput(config, 0); // All ports written together
+        return;
+    }
+    // Write span of changed ports in one burst - output latches are at consecutive addresses
+    uint8_t first = __builtin_ctz(dirty);
+    uint8_t last = 31 - __builtin_clz(dirty);
+    uint8_t values[EXPANDER_MAX_PORTS];
+    for(uint8_t port = first; port <= last; ++port)
+        values[port - first] = config->olat[port];
+    writeExpanderRegisters(config, desc->regOutput + first, values, last - first + 1);
+}
+
+void setExpanderGpiDirection(uint32_t gpi, uint8_t dir) {
+    // Range check already performed by GPI library function
+    uint32_t offset = gpimap[gpi].offset;
+    expandergpidata_t* config = getExpanderConfig(gpimap[gpi].driver);
+    if(!config)
+        return;
+    const expander_desc_t* desc = config->desc;
+    uint8_t port = offset / 8;
+    bitWrite(config->dir[port], offset % 8, !dir); // Bit set for input
+    if(desc->regDirection != EXPANDER_REG_NONE)
+        writeExpanderRegisters(config, desc->regDirection + port, &config->dir[port], 1);
+    else
+        writeExpanderOutput(config, port);
+    if(config->interrupt)
+        writeExpanderIntEnable(config);
+    getGpi(gpi).dir = dir?1:0;
+}
+
+void setExpanderGpiPull(uint32_t gpi, uint8_t mode) {
+    // Range check already performed by GPI library function
+    uint32_t offset = gpimap[gpi].offset;
+    expandergpidata_t* config = getExpanderConfig(gpimap[gpi].driver);
+    if(!config || config->desc->regPull == EXPANDER_REG_NONE || mode == PUD_DOWN)
+        return; // Pull-down not supported by any expander
+    uint8_t port = offset / 8;
+    bitWrite(config->pull[port], offset % 8, mode == PUD_UP);
+    writeExpanderRegisters(config, config->desc->regPull + port, &config->pull[port], 1);
+}
+
+int configureExpanderGpi(uint32_t driver, const gpi_config_t* gpiConfig) {
+    expandergpidata_t* config = getExpanderConfig(driver);
+    if(!config)
+        return -1;
+    const expander_desc_t* desc = config->desc;
+    uint8_t changed = 0;
+    for(uint8_t port = 0; port < desc->ports; ++port) {
+        uint8_t mask = gpiConfig->mask >> (port * 8);
+        uint8_t dir = (config->dir[port] & ~mask) | (~(gpiConfig->output >> (port * 8)) & mask); // Bit set for input
+        changed |= dir != config->dir[port];
+        config->dir[port] = dir;
+        if(desc->regPull != EXPANDER_REG_NONE)
+            config->pull[port] = (config->pull[port] & ~mask) | ((gpiConfig->pullUp >> (port * 8)) & mask); // Pull-down not supported
+    }
+    for(uint32_t offset = 0; offset < gpiDrivers[driver].size; ++offset)
+        gpiDrivers[driver].gpis[offset].dir = !bitRead(config->dir[offset / 8], offset % 8);
+    if(desc->regDirection == EXPANDER_REG_NONE) {
+        // Quasi-bidirectional direction is held in output latch which cannot be read back
+        if(!changed)
+            return 0;
+        return writeExpanderOutput(config, 0) < 0 ? -1 : 1;
+    }
+    // Pull-ups before direction so that new inputs do not float
+    int writes = 0, result;
+    if((result = syncExpanderRegisters(config, desc->regPull, config->pull, desc->ports)) < 0)
+        return -1;
+    writes += result;
+    if((result = syncExpanderRegisters(config, desc->regDirection, config->dir, desc->ports)) < 0)
+        return -1;
+    writes += result;
+    if(config->interrupt) {
+        uint8_t values[EXPANDER_MAX_PORTS];
+        getExpanderIntEnable(config, values);
+        if((result = syncExpanderRegisters(config, desc->regIntEnable, values, desc->ports)) < 0)
+            return -1;
+        writes += result;
+    }
+    return writes;
+}
+
+uint8_t pollExpanderGpi(uint32_t driver) {
+    expandergpidata_t* config = getExpanderConfig(driver);
+    if(!config)
+        return 0;
+    gpi_driver_t* pDriver = &gpiDrivers[driver];
+    uint32_t duePorts = 0;
+    for(int offset = 0; offset < pDriver->size; ++offset)
+        if(isGpiDue(pDriver->gpis[offset]))
+            duePorts |= 1 << (offset / 8);
+    if(!duePorts)
+        return 0;
+    /*  Read span of ports holding due GPI in one transaction. Device without registers is always read from first port.
+        Skip device whilst access is suspended so that a failed device does not delay other drivers.
+    */
+    uint8_t first = config->desc->regInput == EXPANDER_REG_NONE ? 0 : __builtin_ctz(duePorts);
+    uint8_t last = 31 - __builtin_clz(duePorts);
+    uint8_t ports[EXPANDER_MAX_PORTS];
+    uint8_t reg = config->desc->regInput == EXPANDER_REG_NONE ? EXPANDER_REG_NONE : config->desc->regInput + first;
+    if(readExpanderPorts(config, reg, ports + first, last - first + 1) < 0)
+        return 0;
+    uint8_t value, changed = 0;
+    // Update every enabled GPI of ports read, including those not due, as the sample is free
+    for(int offset = first * 8; offset < (last + 1) * 8 && offset < pDriver->size; ++offset) {
+        gpi_t* gpi = &(pDriver->gpis[offset]);
+        if(gpi->enabled) {
+            value = bitRead(ports[offset / 8], offset % 8);
+            if(gpi->value == value)
+                continue;
+            changed = 1;
+            gpi->value = value;
+            notifyGpiChange(pDriver->offset + offset, value);
+        }
+    }
+    return changed;
+}
+
+uint8_t getExpanderGpiStatus(uint32_t driver) {
+    expandergpidata_t* config = getExpanderConfig(driver);
+    if(!config)
+        return GPI_STATUS_INVALID;
+    return config->health.status;
+}
@@ -0,0 +1,172 @@
+/*
+ * ******************************************************************
+ * ZYNTHIAN PROJECT: GPI Library
+ *
+ * Library for interfacing I2C GPI expanders with Zynthian
+ *
+ * Copyright (C) 2021 Brian Walton <riban@zynthian.org>
+ *
+ * ******************************************************************
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * For a full copy of the GNU General Public License see the LICENSE.txt file.
+ *
+ * ******************************************************************
+ */
+
+/*  Generic GPI expander engine driven by device descriptors
+    Each supported device type is described by a constant descriptor defining its port count, register map and features.
+    The engine provides for every device type:
+        Burst read of all input ports in a single transaction per poll
+        Shadowed output, direction and pull registers - only the changed port is written and the device is never read back
+        Optional write-behind of outputs (setGpiWriteBehind) - one output latch burst per device per poll cycle
+        Device health tracking with back-off, quarantine and restoration of shadowed registers after recovery
+    Registers of consecutive ports must be at consecutive addresses, e.g. MCP23017 with IOCON.BANK=0.
+    Devices without registers (quasi-bidirectional, e.g. PCF8574) read and write all ports directly, inputs being written high.
+    To support a new device add a descriptor, a unique driver type and an add function.
+*/
+
+#ifndef ZYNEXPANDERGPI_H_INCLUDED
+#define ZYNEXPANDERGPI_H_INCLUDED
+
+#include "gpi.h"
+
+#define EXPANDER_MAX_PORTS  2 // Maximum quantity of 8-bit ports on an expander
+#define EXPANDER_REG_NONE   0xFF // Descriptor value for register not supported by device
+#define EXPANDER_SPI_ADDRESS(cs, hw) ((cs) << 3 | (hw)) // Bus address of SPI device: chip select and hardware address pins
+
+//  Structure describing bus access to an expander, allowing devices on other buses, e.g. SPI
+typedef struct expander_bus_t {
+    int(*open)(uint8_t address); // Open bus to reach device at address, returning non-negative handle or negative error
+    int(*read)(uint8_t address, uint8_t reg, uint8_t* buffer, uint8_t len); // Read registers (reg EXPANDER_REG_NONE: read without addressing), returning 0 on success
+    int(*write)(uint8_t address, uint8_t reg, const uint8_t* buffer, uint8_t len); // Write registers (reg EXPANDER_REG_NONE: write without addressing), returning 0 on success
+} expander_bus_t;
+
+//  Structure describing a type of expander
+typedef struct expander_desc_t {
+    uint8_t type;           // GPI driver type
+    uint8_t ports;          // Quantity of 8-bit ports [1..EXPANDER_MAX_PORTS]
+    uint8_t addressMin;     // Lowest valid bus address
+    uint8_t addressMax;     // Highest valid bus address
+    uint8_t regInput;       // Input register of first port or EXPANDER_REG_NONE for quasi-bidirectional device without registers
+    uint8_t regOutput;      // Output latch register of first port
+    uint8_t regDirection;   // Direction register of first port (bit set: input) or EXPANDER_REG_NONE
+    uint8_t regPull;        // Pull-up enable register of first port or EXPANDER_REG_NONE
+    uint8_t regPolarity;    // Input polarity inversion register of first port or EXPANDER_REG_NONE
+    uint8_t regIntEnable;   // Interrupt on change enable register of first port or EXPANDER_REG_NONE
+    uint8_t regConfig;      // Device configuration register or EXPANDER_REG_NONE
+    uint8_t regConfigAlt;   // Alternative address of configuration register, e.g. after power on, or EXPANDER_REG_NONE
+    uint8_t configValue;    // Value written to configuration register
+    const expander_bus_t* bus; // Bus access functions
+} expander_desc_t;
+
+extern const expander_bus_t expanderI2cBus; // I2C bus access
+extern const expander_bus_t expanderSpiBus; // SPI bus access using MCP23S17 opcode addressing
+extern const expander_desc_t expanderMcp23008; // Microchip MCP23008 8-bit expander
+extern const expander_desc_t expanderMcp23017; // Microchip MCP23017 16-bit expander (configured for IOCON.BANK=0)
+extern const expander_desc_t expanderMcp23S17; // Microchip MCP23S17 16-bit SPI expander (configured for IOCON.BANK=0, HAEN=1)
+extern const expander_desc_t expanderPca9555; // NXP / TI PCA9555 16-bit expander
+extern const expander_desc_t expanderPcf8574; // NXP / TI PCF8574 8-bit quasi-bidirectional expander
+
+/** @brief  Instantiate an instance of an expander GPI interface driver
+*   @param  desc Pointer to device descriptor
+*   @param  address Bus address
+*   @param  interrupt GPI pin acting as interrupt signal, 0 for none. Enables interrupt on change of inputs if device supports it.
+*   @retval int Index of new GPI driver or -1 on failure
+*   @note   Index of GPI depends on order of instantiation
+*   @note   Returns existing driver if device of same type already added at address
+*   @note   Device already configured, e.g. by a previous process, keeps its output, direction and pull-up registers so that
+*           pins are not disturbed. Otherwise device is initialised with all pins as inputs.
+*/
+int addExpanderGpiDevice(const expander_desc_t* desc, uint8_t address, uint8_t interrupt);
+
+/** @brief  Instantiate an instance of a MCP23008 GPI interface driver providing 8 GPI pins
+*   @param  address I2C address [0x20..0x27]
+*   @retval int Index of new GPI driver or -1 on failure
+*/
+int addMcp23008GpiDevice(uint8_t address);
+
+/** @brief  Instantiate an instance of a MCP23017 GPI interface driver providing 16 GPI pins
+*   @param  address I2C address [0x20..0x27]
+*   @param  interrupt GPI pin acting as interrupt signal
+*   @retval int Index of new GPI driver or -1 on failure
+*/
+int addMcp23017GpiDevice(uint8_t address, uint8_t interrupt);
+
+/** @brief  Instantiate an instance of a MCP23S17 SPI GPI interface driver providing 16 GPI pins
+*   @param  cs SPI chip select [0..SPI_MAX_CS-1]
+*   @param  address Hardware address set by A2..A0 pins [0..7]
+*   @param  interrupt GPI pin acting as interrupt signal
+*   @retval int Index of new GPI driver or -1 on failure
+*   @note   Up to 8 devices may share each chip select. Each poll is a single 4 byte full-duplex transfer.
+*/
+int addMcp23S17GpiDevice(uint8_t cs, uint8_t address, uint8_t interrupt);
+
+/** @brief  Instantiate an instance of a PCA9555 GPI interface driver providing 16 GPI pins
+*   @param  address I2C address [0x20..0x27]
+*   @retval int Index of new GPI driver or -1 on failure
+*/
+int addPca9555GpiDevice(uint8_t address);
+
+/** @brief  Instantiate an instance of a PCF8574 GPI interface driver providing 8 GPI pins
+*   @param  address I2C address [0x20..0x27 for PCF8574, 0x38..0x3F for PCF8574A]
+*   @retval int Index of new GPI driver or -1 on failure
+*/
+int addPcf8574GpiDevice(uint8_t address);
+
+/** @brief  Set GPI state
+*   @param  gpi Index of GPI within global gpimap
+*   @param  state New GPI state
+*/
+void setExpanderGpiState(uint32_t gpi, uint8_t state);
+
+/** @brief  Write output latch changes deferred by write-behind
+*   @param  driver Index of driver
+*   @note   Changed ports are written in a single burst
+*/
+void flushExpanderGpi(uint32_t driver);
+
+/** @brief  Set GPI direction
+*   @param  gpi Index of GPI within global gpimap
+*   @param  dir Direction [0:Input, 1:Output]
+*/
+void setExpanderGpiDirection(uint32_t gpi, uint8_t dir);
+
+/** @brief  Set GPI pull up resistors
+*   @param  gpi Index of GPI within global gpimap
+*   @param  mode Pull mode [PUD_OFF|PUD_UP] - ignored if device does not support pull-up
+*/
+void setExpanderGpiPull(uint32_t gpi, uint8_t mode);
+
+/** @brief  Apply desired configuration, writing only direction, pull-up and interrupt enable registers that differ
+*   @param  driver Index of driver
+*   @param  config Pointer to desired configuration
+*   @retval int Quantity of registers written or -1 on failure
+*   @note   Each register set is read in one transaction and differing ports written in one burst. Pull-down is ignored.
+*/
+int configureExpanderGpi(uint32_t driver, const gpi_config_t* config);
+
+/** @brief  Poll for change of state
+*   @param  driver Index of driver
+*   @retval uint8_t 1 if any GPI within driver has changed else 0
+*/
+uint8_t pollExpanderGpi(uint32_t driver);
+
+/** @brief  Get device status
+*   @param  driver Index of driver
+*   @retval uint8_t Status [GPI_STATUS_OK|GPI_STATUS_RETRY|GPI_STATUS_QUARANTINED|GPI_STATUS_INVALID]
+*   @note   Failed device is skipped by poll until back-off expires then re-probed and re-initialised when it responds
+*/
+uint8_t getExpanderGpiStatus(uint32_t driver);
+
+//-----------------------------------------------------------------------------
+#endif // ZYNEXPANDERGPI_H_INCLUDED
@@ -0,0 +1,68 @@
+/*
+ * ******************************************************************
+ * ZYNTHIAN PROJECT: GPI Library
+ *
+ * Memory backed stand-in for /dev/gpiomem
+ *
+ * Copyright (C) 2021 Brian Walton <riban@zynthian.org>
+ *
+ * ******************************************************************
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * For a full copy of the GNU General Public License see the LICENSE.txt file.
+ *
+ * ******************************************************************
+ */
+
+/*  Allows GPI register access to be exercised on hosts without Raspberry Pi GPI hardware, e.g. by benchmarks and test harnesses.
+    Pass the returned path to setRpiGpiMemDevice (C library) or ribanRpiInterface constructor (C++) and manipulate registers via the returned map.
+*/
+
+#ifndef ZYNFAKEGPIMEM_H_INCLUDED
+#define ZYNFAKEGPIMEM_H_INCLUDED
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE // Provides memfd_create
+#endif
+#include <stdint.h> // Provides fixed width integer types
+#include <stdio.h> // Provides snprintf
+#include <unistd.h> // Provides ftruncate, close
+#include <sys/mman.h> // Provides mmap, memfd_create
+
+#define FAKE_GPIMEM_SIZE    (4 * 1024) // Size of fake GPI register file
+#define FAKE_GPIMEM_PATH_LEN 32 // Minimum size of buffer to hold path of fake GPI register file
+
+/** @brief  Create a memory backed file to stand in for /dev/gpiomem
+*   @param  path Buffer to populate with path of file (at least FAKE_GPIMEM_PATH_LEN bytes)
+*   @param  map Pointer to populate with memory map of file, used to manipulate registers
+*   @retval int File descriptor or -1 on failure
+*/
+static inline int createFakeGpiMem(char* path, volatile uint32_t** map) {
+    int fd = memfd_create("gpiomem", 0);
+    if(fd < 0)
+        return -1;
+    if(ftruncate(fd, FAKE_GPIMEM_SIZE) < 0) {
+        close(fd);
+        return -1;
+    }
+    void* mem = mmap(NULL, FAKE_GPIMEM_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if(mem == MAP_FAILED) {
+        close(fd);
+        return -1;
+    }
+    *map = (volatile uint32_t*)mem;
+    snprintf(path, FAKE_GPIMEM_PATH_LEN, "/proc/self/fd/%d", fd);
+    return fd;
+}
+
+//-----------------------------------------------------------------------------
+#endif // ZYNFAKEGPIMEM_H_INCLUDED
@@ -0,0 +1,264 @@
+/*
+ * ******************************************************************
+ * ZYNTHIAN PROJECT: GPI Library
+ *
+ * Frequency, period and pulse width measurement of native Raspberry Pi GPI
+ *
+ * Copyright (C) 2021 Brian Walton <riban@zynthian.org>
+ *
+ * ******************************************************************
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * For a full copy of the GNU General Public License see the LICENSE.txt file.
+ *
+ * ******************************************************************
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE // Provides pthread_setaffinity_np
+#endif
+#include "freqmeter.h"
+#include "rpigpi.h" // Provides GPI register map
+#include <pthread.h> // Provides thread
+#include <sched.h> // Provides CPU affinity
+#include <string.h> // Provides memset
+#include "timing.h" // Provides timestamps
+#include <time.h> // Provides clock_nanosleep
+
+#define FREQ_MAX_PIN    32
+
+//  Structure holding accumulators of a GPI - written only by sampler thread
+typedef struct freq_accumulator_t {
+    uint32_t seq;           // Sequence counter, odd whilst being updated
+    uint32_t edges;
+    uint32_t periods;
+    uint64_t firstRiseNs;   // Time of first rising edge since reset, 0 if none
+    uint64_t lastRiseNs;    // Time of last rising edge, 0 if none
+    uint64_t lastFallNs;    // Time of last falling edge, 0 if none
+    uint64_t lastPeriodNs;
+    uint64_t highNs;        // Total time spent high between measured edges
+    uint64_t lowNs;         // Total time spent low between measured edges
+    uint64_t minHighNs;
+    uint64_t maxHighNs;
+    uint64_t minLowNs;
+    uint64_t maxLowNs;
+} freq_accumulator_t;
+
+static freq_accumulator_t accumulators[FREQ_MAX_PIN];
+static pthread_t freqThread;
+static uint8_t freqRunning = 0; // 1 whilst sampler thread exists
+static volatile uint8_t freqStop = 0; // 1 to request sampler thread exit
+static uint32_t freqMask = 0; // Bitmask of measured pins
+static uint32_t freqReset = 0; // Bitmask of pins to reset, cleared by sampler thread
+static uint32_t freqInterval = 0; // Sample interval in nanoseconds
+static uint8_t freqSource = FREQ_SOURCE_LEVEL;
+static int freqCpu = -1;
+
+/*  Define private functions */
+static inline void updateMin(uint64_t* min, uint64_t value) {
+    if(!*min || value < *min)
+        *min = value;
+}
+
+static inline void updateMax(uint64_t* max, uint64_t value) {
+    if(value > *max)
+        *max = value;
+}
+
+// Begin update of accumulator - readers retry whilst sequence is odd or changes
+static inline void beginUpdate(freq_accumulator_t* acc) {
+    __atomic_store_n(&acc->seq, acc->seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static inline void endUpdate(freq_accumulator_t* acc) {
+    __atomic_store_n(&acc->seq, acc->seq + 1, __ATOMIC_RELEASE);
+}
+
+void processEdge(freq_accumulator_t* acc, uint8_t rising, uint64_t now) {
+    beginUpdate(acc);
+    ++acc->edges;
+    if(rising) {
+        if(acc->lastRiseNs) {
+            acc->lastPeriodNs = now - acc->lastRiseNs;
+            ++acc->periods;
+        } else {
+            acc->firstRiseNs = now;
+        }
+        if(acc->lastFallNs) {
+            uint64_t low = now - acc->lastFallNs;
+            acc->lowNs += low;
+            updateMin(&acc->minLowNs, low);
+            updateMax(&acc->maxLowNs, low);
+        }
+        acc->lastRiseNs = now;
+    } else {
+        if(acc->lastRiseNs) {
+            uint64_t high = now - acc->lastRiseNs;
+            acc->highNs += high;
+            updateMin(&acc->minHighNs, high);
+            updateMax(&acc->maxHighNs, high);
+        }
+        acc->lastFallNs = now;
+    }
+    endUpdate(acc);
+}
+
+void processReset(uint32_t reset) {
+    while(reset) {
+        uint32_t pin = __builtin_ctz(reset);
+        reset &= reset - 1;
+        freq_accumulator_t* acc = &accumulators[pin];
+        beginUpdate(acc);
+        uint32_t seq = acc->seq;
+        memset(acc, 0, sizeof(freq_accumulator_t));
+        acc->seq = seq;
+        endUpdate(acc);
+    }
+}
+
+// Thread sampling GPI and timestamping edges
+void* sampleFrequency(void* arg) {
+    if(freqCpu >= 0) {
+        // Only raise priority when bound to a dedicated core, otherwise continuous sampling would starve other threads
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(freqCpu, &cpus);
+        if(pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) == 0) {
+            struct sched_param param = {sched_get_priority_max(SCHED_FIFO)};
+            pthread_setschedparam(pthread_self(), SCHED_FIFO, &param); // Best effort
+        }
+    }
+    volatile uint32_t* regs = getRpiGpiMap();
+    uint32_t mask = freqMask;
+    uint32_t last = regs[BCM2835_GPLEV0] & mask;
+    uint64_t next = getTimeNs(); // Same timebase as clock_nanosleep
+    while(!freqStop) {
+        if(freqInterval) {
+            next += freqInterval;
+            struct timespec ts = {next / 1000000000, next % 1000000000};
+            clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+        }
+        uint32_t reset = __atomic_exchange_n(&freqReset, 0, __ATOMIC_ACQUIRE);
+        if(reset)
+            processReset(reset);
+        uint32_t level = regs[BCM2835_GPLEV0] & mask;
+        uint32_t changed = level ^ last;
+        uint32_t pulsed = 0; // Pins that changed and changed back between samples
+        if(freqSource == FREQ_SOURCE_EVENT) {
+            uint32_t events = regs[BCM2835_GPEDS0] & mask;
+            if(events)
+                regs[BCM2835_GPEDS0] = events; // Write 1 to clear
+            pulsed = events & ~changed;
+        }
+        if(!(changed | pulsed))
+            continue;
+        uint64_t now = getCounterNs();
+        last = level;
+        while(changed) {
+            uint32_t pin = __builtin_ctz(changed);
+            changed &= changed - 1;
+            processEdge(&accumulators[pin], (level >> pin) & 1, now);
+        }
+        while(pulsed) {
+            // Pulse too short to measure width - count both edges but only the leading edge contributes to period
+            uint32_t pin = __builtin_ctz(pulsed);
+            pulsed &= pulsed - 1;
+            freq_accumulator_t* acc = &accumulators[pin];
+            uint8_t rising = !((level >> pin) & 1); // Leading edge is opposite to current level
+            if(rising) {
+                processEdge(acc, 1, now);
+                beginUpdate(acc);
+                ++acc->edges;
+                endUpdate(acc);
+            } else {
+                beginUpdate(acc);
+                acc->edges += 2;
+                endUpdate(acc);
+            }
+        }
+    }
+    return NULL;
+}
+
+int startFrequencyMeter(uint32_t mask, uint32_t intervalNs, uint8_t source, int cpu) {
+    volatile uint32_t* regs = getRpiGpiMap();
+    if(freqRunning || !regs || !mask)
+        return -1;
+    for(uint32_t pin = 0; pin < FREQ_MAX_PIN; ++pin)
+        if(mask & (1UL << pin))
+            memset(&accumulators[pin], 0, sizeof(freq_accumulator_t));
+    freqMask = mask;
+    freqReset = 0;
+    freqInterval = intervalNs;
+    freqSource = source;
+    freqCpu = cpu;
+    freqStop = 0;
+    if(source == FREQ_SOURCE_EVENT) {
+        regs[BCM2835_GPREN0] |= mask;
+        regs[BCM2835_GPFEN0] |= mask;
+        regs[BCM2835_GPEDS0] = mask; // Clear stale events
+    }
+    if(pthread_create(&freqThread, NULL, sampleFrequency, NULL))
+        return -1;
+    freqRunning = 1;
+    return 0;
+}
+
+void stopFrequencyMeter() {
+    if(!freqRunning)
+        return;
+    freqStop = 1;
+    pthread_join(freqThread, NULL);
+    freqRunning = 0;
+    volatile uint32_t* regs = getRpiGpiMap();
+    if(freqSource == FREQ_SOURCE_EVENT && regs) {
+        regs[BCM2835_GPREN0] &= ~freqMask;
+        regs[BCM2835_GPFEN0] &= ~freqMask;
+    }
+}
+
+int getGpiFrequency(uint32_t pin, freq_result_t* result) {
+    if(pin >= FREQ_MAX_PIN || !(freqMask & (1UL << pin)) || !result)
+        return -1;
+    freq_accumulator_t* acc = &accumulators[pin];
+    freq_accumulator_t snapshot;
+    uint32_t seq;
+    do {
+        seq = __atomic_load_n(&acc->seq, __ATOMIC_ACQUIRE);
+        if(seq & 1)
+            continue; // Update in progress
+        memcpy(&snapshot, acc, sizeof(snapshot));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while((seq & 1) || seq != __atomic_load_n(&acc->seq, __ATOMIC_RELAXED));
+
+    result->edges = snapshot.edges;
+    result->periods = snapshot.periods;
+    result->frequency = 0;
+    result->lastFrequency = 0;
+    if(snapshot.periods && snapshot.lastRiseNs > snapshot.firstRiseNs) {
+        result->frequency = snapshot.periods * 1e9 / (snapshot.lastRiseNs - snapshot.firstRiseNs);
+        result->lastFrequency = 1e9 / snapshot.lastPeriodNs;
+    }
+    uint64_t total = snapshot.highNs + snapshot.lowNs;
+    result->duty = total ? (double)snapshot.highNs / total : 0;
+    result->minHighNs = snapshot.minHighNs;
+    result->maxHighNs = snapshot.maxHighNs;
+    result->minLowNs = snapshot.minLowNs;
+    result->maxLowNs = snapshot.maxLowNs;
+    return 0;
+}
+
+void resetGpiFrequency(uint32_t pin) {
+    if(pin < FREQ_MAX_PIN)
+        __atomic_fetch_or(&freqReset, 1UL << pin, __ATOMIC_RELEASE);
+}
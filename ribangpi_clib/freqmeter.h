@@ -0,0 +1,85 @@
+/*
+ * ******************************************************************
+ * ZYNTHIAN PROJECT: GPI Library
+ *
+ * Frequency, period and pulse width measurement of native Raspberry Pi GPI
+ *
+ * Copyright (C) 2021 Brian Walton <riban@zynthian.org>
+ *
+ * ******************************************************************
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * For a full copy of the GNU General Public License see the LICENSE.txt file.
+ *
+ * ******************************************************************
+ */
+
+/*  A dedicated sampler thread timestamps each edge on selected native GPI and maintains per-GPI accumulators.
+    Edges are detected by sampling the level register (GPLEV0) or, optionally, also from the event detect latch (GPEDS0)
+    which catches pulses shorter than the sample interval.
+    Accumulators have a single writer (sampler thread) and are read lock-free using a per-GPI sequence counter.
+
+    The native GPI driver (addRpiGpiDevice) must be instantiated before starting measurement.
+    GPI are identified by BCM pin number [0..31].
+*/
+
+#ifndef ZYNFREQMETER_H_INCLUDED
+#define ZYNFREQMETER_H_INCLUDED
+
+#include "gpi.h"
+
+#define FREQ_SOURCE_LEVEL       0 // Detect edges by sampling level register
+#define FREQ_SOURCE_EVENT       1 // Also use rising / falling edge event detect latch to count pulses shorter than sample interval
+
+//  Structure describing measurement of a GPI
+typedef struct freq_result_t {
+    double frequency;       // Mean frequency in Hz between first and last rising edge since reset, 0 if fewer than 2 rising edges
+    double lastFrequency;   // Frequency in Hz of last complete period, 0 if fewer than 2 rising edges
+    double duty;            // Proportion of measured time spent high [0..1]
+    uint32_t edges;         // Quantity of edges detected since reset, including those only seen by event detect latch
+    uint32_t periods;       // Quantity of complete periods (rising to rising edge) measured since reset
+    uint64_t minHighNs;     // Shortest high pulse in nanoseconds, 0 if none measured
+    uint64_t maxHighNs;     // Longest high pulse in nanoseconds
+    uint64_t minLowNs;      // Shortest low pulse in nanoseconds, 0 if none measured
+    uint64_t maxLowNs;      // Longest low pulse in nanoseconds
+} freq_result_t;
+
+/** @brief  Start measuring frequency of native GPI
+*   @param  mask Bitmask of BCM pins to measure
+*   @param  intervalNs Sample interval in nanoseconds, 0 to sample continuously
+*   @param  source Edge detection source [FREQ_SOURCE_LEVEL|FREQ_SOURCE_EVENT]
+*   @param  cpu Index of CPU core dedicated to sampler thread or -1 for no affinity
+*   @retval int 0 on success or -1 on failure, e.g. already running or native GPI driver not instantiated
+*   @note   Accumulators of selected GPI are reset
+*/
+int startFrequencyMeter(uint32_t mask, uint32_t intervalNs, uint8_t source, int cpu);
+
+/** @brief  Stop measuring frequency
+*   @note   Results remain available until next start
+*/
+void stopFrequencyMeter();
+
+/** @brief  Get measurement of a GPI
+*   @param  pin BCM pin number
+*   @param  result Pointer to structure to populate
+*   @retval int 0 on success or -1 if pin is not measured
+*/
+int getGpiFrequency(uint32_t pin, freq_result_t* result);
+
+/** @brief  Reset accumulators of a GPI
+*   @param  pin BCM pin number
+*   @note   Reset is performed by sampler thread at its next sample
+*/
+void resetGpiFrequency(uint32_t pin);
+
+//-----------------------------------------------------------------------------
+#endif // ZYNFREQMETER_H_INCLUDED
@@ -0,0 +1,164 @@
+/*
+ * ******************************************************************
+ * ZYNTHIAN PROJECT: GPI Library
+ *
+ * Button gesture recognition for Zynthian GPI library
+ *
+ * Copyright (C) 2021 Brian Walton <riban@zynthian.org>
+ *
+ * ******************************************************************
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * For a full copy of the GNU General Public License see the LICENSE.txt file.
+ *
+ * ******************************************************************
+ */
+
+#include "gesture.h"
+#include "events.h" // Provides event queue
+#include "timing.h" // Provides timestamps
+#include <pthread.h> // Provides mutex
+#include <string.h> // Provides memset
+
+#define MS_NS   1000000ULL // Nanoseconds per millisecond
+
+//  Structure describing gesture configuration and state of a GPI
+typedef struct gesture_t {
+    uint8_t enabled;        // 1 if gesture recognition enabled
+    uint8_t activeLow;      // 1 if GPI is active when low
+    uint8_t pressed;        // 1 if GPI is active
+    uint8_t longSent;       // 1 if long press event queued for current press
+    uint32_t longPress;     // Time held before long press event in milliseconds, 0 if disabled
+    uint32_t doubleClick;   // Maximum release to press time of double click in milliseconds, 0 if disabled
+    uint32_t repeatDelay;   // Time held before first repeat in milliseconds, 0 if disabled
+    uint32_t repeatPeriod;  // Time between repeats in milliseconds
+    uint32_t repeats;       // Quantity of repeat events queued for current press
+    uint64_t pressTime;     // Time of current press in nanoseconds
+    uint64_t clickTime;     // Time of release of last short press in nanoseconds, 0 if none
+    uint64_t nextRepeat;    // Time of next repeat event in nanoseconds
+} gesture_t;
+
+static pthread_mutex_t gestureMutex = PTHREAD_MUTEX_INITIALIZER; // Protects gesture table
+static gesture_t gestures[MAX_GPI]; // Gesture state indexed by GPI
+static uint32_t gesturesPending = 0; // Quantity of GPI pressed with a time based gesture outstanding
+
+/*  Define private functions */
+// Check if GPI has a time based gesture still to be queued for current press - call with gestureMutex locked
+uint8_t isGesturePending(gesture_t* gesture) {
+    return gesture->pressed && ((gesture->longPress && !gesture->longSent) || gesture->repeatDelay);
+}
+
+// Reset gesture state without queuing events - call with gestureMutex locked
+void resetGesture(gesture_t* gesture) {
+    if(gesture->enabled && isGesturePending(gesture))
+        --gesturesPending;
+    memset(gesture, 0, sizeof(gesture_t));
+}
+
+int setGpiGesture(uint32_t gpi, uint8_t activeLow, uint32_t longPress, uint32_t doubleClick, uint32_t repeatDelay, uint32_t repeatPeriod) {
+    if(gpi >= MAX_GPI || (repeatDelay && !repeatPeriod))
+        return -1;
+    pthread_mutex_lock(&gestureMutex);
+    gesture_t* gesture = &gestures[gpi];
+    resetGesture(gesture);
+    gesture->activeLow = activeLow ? 1 : 0;
+    gesture->longPress = longPress;
+    gesture->doubleClick = doubleClick;
+    gesture->repeatDelay = repeatDelay;
+    gesture->repeatPeriod = repeatPeriod;
+    gesture->pressed = getState(gpi) ^ gesture->activeLow;
+    if(gesture->pressed) {
+        // Already held: time gestures from now
+        gesture->pressTime = getCounterNs();
+        gesture->nextRepeat = gesture->pressTime + repeatDelay * MS_NS;
+        if(isGesturePending(gesture))
+            ++gesturesPending;
+    }
+    __atomic_store_n(&gesture->enabled, 1, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&gestureMutex);
+    return 0;
+}
+
+void removeGpiGesture(uint32_t gpi) {
+    if(gpi >= MAX_GPI)
+        return;
+    pthread_mutex_lock(&gestureMutex);
+    resetGesture(&gestures[gpi]);
+    pthread_mutex_unlock(&gestureMutex);
+}
+
+void clearGpiGestures() {
+    pthread_mutex_lock(&gestureMutex);
+    memset(gestures, 0, sizeof(gestures));
+    gesturesPending = 0;
+    pthread_mutex_unlock(&gestureMutex);
+}
+
+void gestureGpiChange(uint32_t gpi, uint8_t value, uint64_t timestamp) {
+    // Avoid taking lock for GPI without gesture recognition
+    if(gpi >= MAX_GPI || !__atomic_load_n(&gestures[gpi].enabled, __ATOMIC_RELAXED))
+        return;
+    pthread_mutex_lock(&gestureMutex);
+    gesture_t* gesture = &gestures[gpi];
+    value = value ? 1 : 0;
+    uint8_t pressed = value ^ gesture->activeLow;
+    if(gesture->enabled && pressed != gesture->pressed) {
+        if(isGesturePending(gesture))
+            --gesturesPending;
+        gesture->pressed = pressed;
+        if(pressed) {
+            gesture->pressTime = timestamp;
+            gesture->longSent = 0;
+            gesture->repeats = 0;
+            gesture->nextRepeat = timestamp + gesture->repeatDelay * MS_NS;
+            queueGpiEvent(gpi, GPI_EVENT_PRESS, value, 0);
+            if(gesture->clickTime && timestamp - gesture->clickTime <= gesture->doubleClick * MS_NS) {
+                gesture->clickTime = 0; // Third click starts a new sequence
+                queueGpiEvent(gpi, GPI_EVENT_DOUBLE_CLICK, value, 2);
+            }
+            if(isGesturePending(gesture))
+                ++gesturesPending;
+        } else {
+            uint64_t duration = timestamp - gesture->pressTime;
+            // Only a short press may be the first click of a double click
+            gesture->clickTime = (gesture->doubleClick && !gesture->longSent && !gesture->repeats) ? timestamp : 0;
+            queueGpiEvent(gpi, GPI_EVENT_RELEASE, value, duration / MS_NS);
+        }
+    }
+    pthread_mutex_unlock(&gestureMutex);
+}
+
+void updateGestures() {
+    if(!__atomic_load_n(&gesturesPending, __ATOMIC_RELAXED))
+        return;
+    uint64_t now = getCounterNs();
+    pthread_mutex_lock(&gestureMutex);
+    for(uint32_t gpi = 0; gpi < MAX_GPI && gesturesPending; ++gpi) {
+        gesture_t* gesture = &gestures[gpi];
+        if(!gesture->enabled || !isGesturePending(gesture))
+            continue;
+        uint8_t value = gesture->activeLow ^ 1;
+        if(gesture->longPress && !gesture->longSent && now - gesture->pressTime >= gesture->longPress * MS_NS) {
+            gesture->longSent = 1;
+            queueGpiEvent(gpi, GPI_EVENT_LONG_PRESS, value, (now - gesture->pressTime) / MS_NS);
+            if(!isGesturePending(gesture))
+                --gesturesPending;
+        }
+        if(gesture->repeatDelay && now >= gesture->nextRepeat) {
+            gesture->nextRepeat += gesture->repeatPeriod * MS_NS;
+            if(gesture->nextRepeat <= now)
+                gesture->nextRepeat = now + gesture->repeatPeriod * MS_NS; // Overrun: skip missed repeats
+            queueGpiEvent(gpi, GPI_EVENT_REPEAT, value, ++gesture->repeats);
+        }
+    }
+    pthread_mutex_unlock(&gestureMutex);
+}
@@ -0,0 +1,78 @@
+/*
+ * ******************************************************************
+ * ZYNTHIAN PROJECT: GPI Library
+ *
+ * Button gesture recognition for Zynthian GPI library
+ *
+ * Copyright (C) 2021 Brian Walton <riban@zynthian.org>
+ *
+ * ******************************************************************
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * For a full copy of the GNU General Public License see the LICENSE.txt file.
+ *
+ * ******************************************************************
+ */
+
+/*  Gesture recognition runs a state machine per GPI within the poll thread, timed by the sample clock, and queues typed
+    events so that applications do not need their own timers:
+        GPI_EVENT_PRESS: GPI became active
+        GPI_EVENT_RELEASE: GPI became inactive, data: press duration in milliseconds
+        GPI_EVENT_LONG_PRESS: GPI held active for long press time, data: press duration in milliseconds
+        GPI_EVENT_REPEAT: GPI held active for repeat delay then each repeat period, data: quantity of repeats
+        GPI_EVENT_DOUBLE_CLICK: GPI became active within double click time of a short press being released
+    Press and release are always queued, e.g. double click follows the press event of the second click, so single clicks are
+    not delayed waiting to see if a second click follows. Timing resolution is the poll period of the GPI rate class.
+    Events must be enabled with enableGpiEvents and GPI must be enabled so that changes are detected.
+*/
+
+#ifndef ZYNGPIGESTURE_H_INCLUDED
+#define ZYNGPIGESTURE_H_INCLUDED
+
+#include "gpi.h"
+
+/** @brief  Enable gesture recognition for a GPI
+*   @param  gpi Index of GPI within global gpimap
+*   @param  activeLow 1 if GPI is active when low, e.g. button to ground with pull-up
+*   @param  longPress Time held before long press event in milliseconds, 0 to disable
+*   @param  doubleClick Maximum time from release to next press for double click event in milliseconds, 0 to disable
+*   @param  repeatDelay Time held before first repeat event in milliseconds, 0 to disable repeat
+*   @param  repeatPeriod Time between subsequent repeat events in milliseconds [>0 if repeatDelay set]
+*   @retval int 0 on success or -1 on invalid parameter
+*   @note   Replaces any existing gesture configuration of the GPI. Current GPI value is taken as initial state.
+*/
+int setGpiGesture(uint32_t gpi, uint8_t activeLow, uint32_t longPress, uint32_t doubleClick, uint32_t repeatDelay, uint32_t repeatPeriod);
+
+/** @brief  Disable gesture recognition for a GPI
+*   @param  gpi Index of GPI within global gpimap
+*/
+void removeGpiGesture(uint32_t gpi);
+
+/** @brief  Disable gesture recognition for all GPI
+*/
+void clearGpiGestures();
+
+/** @brief  Advance gesture state machine of a GPI on change of value
+*   @param  gpi Index of GPI within global gpimap
+*   @param  value New GPI value
+*   @param  timestamp Time of sample in nanoseconds (getCounterNs timebase)
+*   @note   Called by notifyGpiChange
+*/
+void gestureGpiChange(uint32_t gpi, uint8_t value, uint64_t timestamp);
+
+/** @brief  Queue time based gestures, i.e. long press and repeat, that have become due
+*   @note   Called by poll thread each cycle
+*/
+void updateGestures();
+
+//-----------------------------------------------------------------------------
+#endif // ZYNGPIGESTURE_H_INCLUDED
@@ -23,14 +23,33 @@
  * ******************************************************************
  */
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE // Provides PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP
+#endif
+
 #include "gpi.h"
+#include "stats.h" // Provides instrumentation
+#include "events.h" // Provides event queue
+#include "midi.h" // Provides MIDI bridge
+#include "gesture.h" // Provides gesture recognition
+#include "timing.h" // Provides timestamps
 #include <pthread.h> // Provdes thread
 #include <string.h> // Provides strerror
 
 pthread_t pollThread;
+static pthread_mutex_t driverMutex = PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP; // Protects driver table from concurrent access by poll thread, recursive so change callback may call setters
+static pthread_cond_t pollCond = PTHREAD_COND_INITIALIZER; // Signals poll thread when driver table changes or shutdown requested
+static uint8_t pollThreadRunning = 0; // 1 if poll thread has been created
+static uint8_t pollThreadStop = 0; // 1 to request poll thread exit
+static uint32_t ratePeriods[GPI_RATE_CLASSES] = {POLL_SLEEP_US, POLL_SLEEP_US, POLL_SLEEP_US, POLL_SLEEP_US}; // Sampling period of each rate class in microseconds
+static int pollPolicy = SCHED_OTHER; // Scheduling policy of poll thread
+static int pollPriority = 0; // Scheduling priority of poll thread
+static uint8_t writeBehind = 0; // 1 to defer output writes to poll thread
+static void(*changeCallback)(uint32_t, uint8_t) = NULL; // Function called when GPI value changes
 gpi_driver_t gpiDrivers[MAX_GPI_DRIVERS];
 gpi_map_t gpimap[MAX_GPI];
 uint32_t zynGpiCount = 0;
+uint8_t gpiDueClasses = GPI_RATE_ALL;
 
 /*  Define private functions */
 void * poll_gpi(void *arg);
@@ -39,30 +58,193 @@ void resetDriver(uint8_t driver) {
         gpiDrivers[driver].size = 0;
         gpiDrivers[driver].offset = 0;
         gpiDrivers[driver].config = NULL;
+        gpiDrivers[driver].gpis = NULL;
         gpiDrivers[driver].destroy = NULL;
         gpiDrivers[driver].setState = NULL;
         gpiDrivers[driver].setPull = NULL;
+        gpiDrivers[driver].setDirection = NULL;
         gpiDrivers[driver].poll = NULL;
+        gpiDrivers[driver].getStatus = NULL;
+        gpiDrivers[driver].flush = NULL;
+        gpiDrivers[driver].configure = NULL;
+}
+
+// Write pending output changes of all drivers - call with driverMutex locked
+void flushDrivers() {
+    for(int i = 0; i < MAX_GPI_DRIVERS; ++i)
+        if(gpiDrivers[i].flush)
+            gpiDrivers[i].flush(i);
+}
+
+// Get quantity of drivers that require polling - call with driverMutex locked
+uint8_t getPollingDriverCount() {
+    uint8_t count = 0;
+    for(int i = 0; i < MAX_GPI_DRIVERS; ++i)
+        if(gpiDrivers[i].poll)
+            ++count;
+    return count;
+}
+
+// Get bitmask of rate classes with enabled GPI, including default class which schedules write-behind - call with driverMutex locked
+uint8_t getUsedRateClasses() {
+    uint8_t used = 1 << GPI_RATE_DEFAULT;
+    for(uint32_t gpi = 0; gpi < zynGpiCount; ++gpi)
+        if(getGpi(gpi).enabled)
+            used |= 1 << getGpi(gpi).rateClass;
+    return used;
+}
+
+// Check if driver has GPI due in current poll cycle - call with driverMutex locked
+uint8_t isDriverDue(uint8_t driver) {
+    for(uint32_t offset = 0; offset < gpiDrivers[driver].size; ++offset)
+        if(isGpiDue(gpiDrivers[driver].gpis[offset]))
+            return 1;
+    return 0;
 }
 
 // Run when library loaded
 void __attribute__ ((constructor)) init() {
     for(int i = 0; i < MAX_GPI_DRIVERS; ++i)
         resetDriver(i);
-    int err = pthread_create(&pollThread, NULL, &poll_gpi, NULL);
-	if (err)
-		fprintf(stderr, "ZynGPI: Can't create poll thread :[%s]", strerror(err));
+    // Poll thread is started by updatePolling() when first polling driver is added
 
     //!@todo Init low-level libs as required, e.g. wiringPi
 }
 
 // Run when library unloaded
 void __attribute__ ((destructor)) onexit() {
-    printf("zyngpi lib exit\n");
+    shutdownGpi();
+}
+
+void lockGpiDrivers() {
+    pthread_mutex_lock(&driverMutex);
+}
+
+void unlockGpiDrivers() {
+    pthread_mutex_unlock(&driverMutex);
+}
+
+void updatePolling() {
+    pthread_mutex_lock(&driverMutex);
+    if(getPollingDriverCount() && !pollThreadRunning && !pollThreadStop) {
+        getCounterNs(); // Calibrate timestamp counter before poll thread depends on it
+        int err = pthread_create(&pollThread, NULL, &poll_gpi, NULL);
+        if(err) {
+            fprintf(stderr, "ZynGPI: Can't create poll thread :[%s]", strerror(err));
+        } else {
+            pollThreadRunning = 1;
+            if(pollPolicy != SCHED_OTHER) {
+                struct sched_param param = {pollPriority};
+                pthread_setschedparam(pollThread, pollPolicy, &param);
+            }
+        }
+    }
+    pthread_cond_signal(&pollCond); // Wake parked poll thread to re-evaluate driver table
+    pthread_mutex_unlock(&driverMutex);
+}
+
+void setPollPeriod(uint32_t us) {
+    setGpiRatePeriod(GPI_RATE_DEFAULT, us);
+}
+
+uint32_t getPollPeriod() {
+    return getGpiRatePeriod(GPI_RATE_DEFAULT);
+}
+
+void setGpiRatePeriod(uint8_t rateClass, uint32_t us) {
+    if(us && rateClass < GPI_RATE_CLASSES)
+        __atomic_store_n(&ratePeriods[rateClass], us, __ATOMIC_RELAXED);
+}
+
+uint32_t getGpiRatePeriod(uint8_t rateClass) {
+    if(rateClass >= GPI_RATE_CLASSES)
+        return 0;
+    return __atomic_load_n(&ratePeriods[rateClass], __ATOMIC_RELAXED);
+}
+
+uint8_t setGpiRate(uint32_t gpi, uint8_t rateClass) {
+    if(gpi >= zynGpiCount || rateClass >= GPI_RATE_CLASSES)
+        return 0;
+    getGpi(gpi).rateClass = rateClass;
+    return 1;
+}
+
+uint8_t getGpiRate(uint32_t gpi) {
+    if(gpi >= zynGpiCount)
+        return GPI_RATE_DEFAULT;
+    return getGpi(gpi).rateClass;
+}
+
+void setGpiWriteBehind(uint8_t enable) {
+    __atomic_store_n(&writeBehind, enable ? 1 : 0, __ATOMIC_RELAXED);
+    if(!enable)
+        flushGpi();
+}
+
+uint8_t getGpiWriteBehind() {
+    return __atomic_load_n(&writeBehind, __ATOMIC_RELAXED);
+}
+
+void flushGpi() {
+    pthread_mutex_lock(&driverMutex);
+    flushDrivers();
+    pthread_mutex_unlock(&driverMutex);
+}
+
+int setPollScheduling(int policy, int priority) {
+    int err = 0;
+    pthread_mutex_lock(&driverMutex);
+    pollPolicy = policy;
+    pollPriority = priority;
+    if(pollThreadRunning) {
+        struct sched_param param = {priority};
+        err = pthread_setschedparam(pollThread, policy, &param);
+    }
+    pthread_mutex_unlock(&driverMutex);
+    return err;
+}
+
+void setGpiChangeCallback(void(*callback)(uint32_t gpi, uint8_t value)) {
+    pthread_mutex_lock(&driverMutex);
+    changeCallback = callback;
+    pthread_mutex_unlock(&driverMutex);
+}
+
+void notifyGpiChange(uint32_t gpi, uint8_t value) {
+    statsRecordEvent(gpi);
+    queueGpiEvent(gpi, GPI_EVENT_CHANGE, value, 1);
+    gestureGpiChange(gpi, value, getCounterNs());
+    midiGpiChange(gpi, value);
+    if(changeCallback)
+        changeCallback(gpi, value);
+}
+
+void shutdownGpi() {
+    // Stop and join poll thread
+    pthread_mutex_lock(&driverMutex);
+    pollThreadStop = 1;
+    pthread_cond_signal(&pollCond);
+    uint8_t running = pollThreadRunning;
+    pthread_mutex_unlock(&driverMutex);
+    if(running)
+        pthread_join(pollThread, NULL);
+
+    // Destroy drivers in reverse order of instantiation
+    pthread_mutex_lock(&driverMutex);
+    flushDrivers();
     for(int i = MAX_GPI_DRIVERS - 1; i >= 0; --i) {
-        if(gpiDrivers[i].type)
-            printf("Need to destroy driver %d of type %d\n", i, gpiDrivers[i].type);
+        if(gpiDrivers[i].type == GPI_DRIVER_NONE)
+            continue;
+        if(gpiDrivers[i].destroy)
+            gpiDrivers[i].destroy();
+        free(gpiDrivers[i].gpis);
+        free(gpiDrivers[i].config);
+        resetDriver(i);
     }
+    zynGpiCount = 0;
+    pollThreadRunning = 0;
+    pollThreadStop = 0; // Allow library to be used again
+    pthread_mutex_unlock(&driverMutex);
 }
 
 void printInfo() {
@@ -103,17 +285,17 @@ uint8_t getDirection(uint32_t gpi) {
 }
 
 void setDirection(uint32_t gpi, uint8_t dir) {
-    if(gpi >= zynGpiCount)
-        return;
-    if(gpiDrivers[gpimap[gpi].driver].setDirection)
+    pthread_mutex_lock(&driverMutex);
+    if(gpi < zynGpiCount && gpiDrivers[gpimap[gpi].driver].setDirection)
         gpiDrivers[gpimap[gpi].driver].setDirection(gpi, dir);
+    pthread_mutex_unlock(&driverMutex);
 }
 
 void setPull(uint32_t gpi, uint8_t mode) {
-    if(gpi >= zynGpiCount)
-        return;
-    if(gpiDrivers[gpimap[gpi].driver].setPull)
+    pthread_mutex_lock(&driverMutex);
+    if(gpi < zynGpiCount && gpiDrivers[gpimap[gpi].driver].setPull)
         gpiDrivers[gpimap[gpi].driver].setPull(gpi, mode);
+    pthread_mutex_unlock(&driverMutex);
 }
 
 uint8_t getState(uint32_t gpi) {
@@ -123,25 +305,48 @@ uint8_t getState(uint32_t gpi) {
 }
 
 void setState(uint32_t gpi, uint8_t state) {
-    if(gpi >= zynGpiCount)
-        return;
-    gpiDrivers[gpimap[gpi].driver].setState(gpimap[gpi].offset, state?1:0);
-    getGpi(gpi).value = state; //!@todo Move this to device specific to ensure the state is correct
+    pthread_mutex_lock(&driverMutex);
+    if(gpi < zynGpiCount && gpiDrivers[gpimap[gpi].driver].setState) {
+        gpiDrivers[gpimap[gpi].driver].setState(gpi, state?1:0);
+        getGpi(gpi).value = state; //!@todo Move this to device specific to ensure the state is correct
+    }
+    pthread_mutex_unlock(&driverMutex);
+}
+
+int configureGpiDriver(uint32_t driver, const gpi_config_t* config) {
+    if(driver >= MAX_GPI_DRIVERS || !config)
+        return -1;
+    pthread_mutex_lock(&driverMutex);
+    int result = gpiDrivers[driver].configure ? gpiDrivers[driver].configure(driver, config) : -1;
+    pthread_mutex_unlock(&driverMutex);
+    return result;
+}
+
+uint8_t getGpiDriverStatus(uint32_t driver) {
+    if(driver >= MAX_GPI_DRIVERS || gpiDrivers[driver].type == GPI_DRIVER_NONE)
+        return GPI_STATUS_INVALID;
+    if(gpiDrivers[driver].getStatus)
+        return gpiDrivers[driver].getStatus(driver);
+    return GPI_STATUS_OK;
 }
 
 void removeGpiDevice(uint32_t driver) {
     if(driver >= MAX_GPI_DRIVERS)
         return;
 
+    pthread_mutex_lock(&driverMutex);
     uint32_t offset = gpiDrivers[driver].offset;
     uint32_t size = gpiDrivers[driver].size;
 
     // Call driver specific code
+    if(gpiDrivers[driver].flush)
+        gpiDrivers[driver].flush(driver);
     if(gpiDrivers[driver].destroy)
         gpiDrivers[driver].destroy();
 
     // Recover memory
     free(gpiDrivers[driver].gpis);
+    free(gpiDrivers[driver].config);
 
     // Move drivers to fill the gap
     for(int i = driver; i < MAX_GPI_DRIVERS - 1; ++i) {
@@ -153,23 +358,71 @@ void removeGpiDevice(uint32_t driver) {
     }
     resetDriver(MAX_GPI_DRIVERS - 1); // Last driver must be empty
 
-    for(int i = offset; i < offset + size * 2; ++i) {
+    // Close gap in map without reading beyond instantiated GPI - later GPI now belong to preceding driver index
+    for(uint32_t i = offset; i + size < zynGpiCount; ++i) {
         gpimap[i] = gpimap[i + size]; // Implicit struct copy
-        gpimap[i].offset -= size;
+        --gpimap[i].driver;
     }
     zynGpiCount -= size;
-    //!@todo Update polling if required
+    pthread_mutex_unlock(&driverMutex);
+    updatePolling(); // Park poll thread if no polling drivers remain
     //!@todo Close I2C device if required
 }
 
 //  Thread to poll GPI
 void * poll_gpi(void *arg) {
-	while (1) {
-		for(int i = 0; i < MAX_GPI_DRIVERS; ++i) {
-            if(gpiDrivers[i].poll)
+    uint64_t deadlines[GPI_RATE_CLASSES] = {0}; // Time each rate class is next due in nanoseconds
+    pthread_mutex_lock(&driverMutex);
+    while(!pollThreadStop) {
+        if(!getPollingDriverCount()) {
+            // Park until a polling driver is added or shutdown requested
+            pthread_cond_wait(&pollCond, &driverMutex);
+            continue;
+        }
+        // Schedule each rate class at its own period, each class without enabled GPI is due as soon as it gains one
+        uint64_t now = getCounterNs();
+        uint8_t used = getUsedRateClasses();
+        uint8_t due = 0;
+        for(uint8_t rateClass = 0; rateClass < GPI_RATE_CLASSES; ++rateClass) {
+            if(!bitRead(used, rateClass)) {
+                deadlines[rateClass] = now;
+                continue;
+            }
+            if(now < deadlines[rateClass])
+                continue;
+            due |= 1 << rateClass;
+            deadlines[rateClass] += getGpiRatePeriod(rateClass) * 1000ULL;
+            if(deadlines[rateClass] <= now)
+                deadlines[rateClass] = now + getGpiRatePeriod(rateClass) * 1000ULL; // Overrun: skip missed samples
+        }
+        gpiDueClasses = due;
+        for(int i = 0; i < MAX_GPI_DRIVERS; ++i) {
+            if(gpiDrivers[i].flush)
+                gpiDrivers[i].flush(i); // Write-behind outputs: one write per device per cycle
+            if(gpiDrivers[i].poll && isDriverDue(i)) {
+                uint64_t start = getCounterNs();
                 gpiDrivers[i].poll(i);
-		}
-		usleep(POLL_SLEEP_US);
-	}
-	return NULL;
+                statsRecordPoll(i, (getCounterNs() - start) / 1000);
+            }
+        }
+        gpiDueClasses = GPI_RATE_ALL; // Direct calls to driver poll functions sample all GPI
+        pthread_mutex_unlock(&driverMutex);
+        flushMidi(); // One write per cycle for all MIDI generated by this cycle
+        updateGestures(); // Queue long press and repeat events that have become due
+        releaseGpiEvents(); // Queue events held by rate limiting whose interval has expired
+        // Sleep until next rate class is due
+        uint64_t next = UINT64_MAX;
+        for(uint8_t rateClass = 0; rateClass < GPI_RATE_CLASSES; ++rateClass)
+            if(bitRead(used, rateClass) && deadlines[rateClass] < next)
+                next = deadlines[rateClass];
+        uint64_t sleepStart = getCounterNs();
+        int64_t period = next > sleepStart ? (next - sleepStart) / 1000 : 0;
+        if(period)
+            usleep(period);
+        int64_t drift = (int64_t)(getCounterNs() - sleepStart) / 1000 - period;
+        statsRecordJitter(drift < 0 ? -drift : drift);
+        pthread_mutex_lock(&driverMutex);
+    }
+    pthread_mutex_unlock(&driverMutex);
+    return NULL;
 }
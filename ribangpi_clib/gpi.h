@@ -27,7 +27,10 @@
 
 #define MAX_GPI_DRIVERS         8 //!@todo Make this dynamic
 #define MAX_GPI                 256 //!@todo Make this dynamic
-#define POLL_SLEEP_US           10000 //!@todo Make this tunable
+#define POLL_SLEEP_US           10000 // Default poll period, adjust with setPollPeriod
+#define GPI_RATE_CLASSES        4 // Quantity of sampling rate classes
+#define GPI_RATE_DEFAULT        0 // Rate class of each GPI when driver added, sampled at poll period
+#define GPI_RATE_ALL            ((1 << GPI_RATE_CLASSES) - 1) // Bitmask of all rate classes
 
 /*  List of GPI driver types */
 #define GPI_DRIVER_NONE         0
@@ -35,6 +38,10 @@
 #define GPI_DRIVER_MCP23008     2
 #define GPI_DRIVER_MCP23017     3
 #define GPI_DRIVER_RIBAN_I2C    4
+#define GPI_DRIVER_PCA9555      5
+#define GPI_DRIVER_PCF8574      6
+#define GPI_DRIVER_ADS1115      7
+#define GPI_DRIVER_MCP23S17     8
 
 #include "stdint.h" // Provides fixed width interger types
 #include "stdio.h" // Provides NULL
@@ -47,20 +54,36 @@
 #define PUD_DOWN    1
 #define PUD_UP      2
 
+/*  Driver status */
+#define GPI_STATUS_OK           0 // Device operating normally
+#define GPI_STATUS_RETRY        1 // Device failed recently, access suspended until back-off expires
+#define GPI_STATUS_QUARANTINED  2 // Device failed repeatedly, access suspended except for periodic re-probe
+#define GPI_STATUS_INVALID      255 // No such driver
+
  /* Helper functions */
 #define getGpi(index) gpiDrivers[gpimap[index].driver].gpis[gpimap[index].offset]
 #define bitRead(value, bit) (((value) >> (bit)) & 0x01)
 #define bitSet(value, bit) ((value) |= (1UL << (bit)))
 #define bitClear(value, bit) ((value) &= ~(1UL << (bit)))
 #define bitWrite(value, bit, bitvalue) (bitvalue ? bitSet(value, bit) : bitClear(value, bit))
+#define isGpiDue(gpi) ((gpi).enabled && bitRead(gpiDueClasses, (gpi).rateClass)) // True if enabled GPI should be sampled by current poll
 
 //  Structure describing an individual GPI
 typedef struct gpi_t {
     uint8_t value:1;        // Current state / value [0|1]
     uint8_t enabled:1;      // 1 if enabled
     uint8_t dir:1;          // Input / output
+    uint8_t rateClass:2;    // Sampling rate class [0..GPI_RATE_CLASSES-1]
 } gpi_t;
 
+//  Structure describing desired configuration of GPI within a driver, applied by configureGpiDriver
+typedef struct gpi_config_t {
+    uint64_t mask;          // GPI to configure, bit n: GPI at offset n within driver
+    uint64_t output;        // Direction, bit set: output, clear: input
+    uint64_t pullUp;        // Bit set: enable pull-up
+    uint64_t pullDown;      // Bit set: enable pull-down (ignored if not supported by device)
+} gpi_config_t;
+
 //  Structure describing GPI driver
 typedef struct gpi_driver_t {
     uint8_t type;           // Driver type
@@ -75,6 +98,9 @@ typedef struct gpi_driver_t {
     void(*destroy)();                               // Function called when driver removed
     void(*setDirection)(uint32_t gpi, uint8_t dir); // Function to set GPI direction
     uint8_t(*poll)(uint32_t);                       // Function to poll GPI states, NULL for no polling
+    uint8_t(*getStatus)(uint32_t driver);           // Function to get device status, NULL if device cannot fail
+    void(*flush)(uint32_t driver);                  // Function to write pending output changes, NULL if outputs are written immediately
+    int(*configure)(uint32_t driver, const gpi_config_t* config); // Function to apply desired configuration, NULL if not supported
 } gpi_driver_t;
 
 //  Structure describing map of GPI index to its driver
@@ -86,12 +112,110 @@ typedef struct {
 extern gpi_driver_t gpiDrivers[]; // Map of driver structures mapped by global GPI driver number
 extern gpi_map_t gpimap[];  // Map of drivers,offset indexed by global GPI number
 extern uint32_t zynGpiCount;      // Quantity of instantiated GPIs
+extern uint8_t gpiDueClasses; // Bitmask of rate classes due in current poll cycle, GPI_RATE_ALL outside poll thread cycle
 
 
 /** @brief  Initialise GPI driver
+*   @note   Poll thread is not started until a driver that requires polling is added
 */
 void init();
 
+/** @brief  Stop poll thread and destroy all drivers
+*   @note   Blocks until poll thread has exited. Called automatically when library unloaded.
+*/
+void shutdownGpi();
+
+/** @brief  Start, wake or park poll thread to match drivers that require polling
+*   @note   Called by driver specific code after adding or removing a driver
+*/
+void updatePolling();
+
+/** @brief  Set period of poll thread
+*   @param  us Time between each poll of GPI in default rate class in microseconds [>0]
+*   @note   Equivalent to setGpiRatePeriod(GPI_RATE_DEFAULT, us)
+*/
+void setPollPeriod(uint32_t us);
+
+/** @brief  Get period of poll thread
+*   @retval uint32_t Time between each poll of GPI in default rate class in microseconds
+*/
+uint32_t getPollPeriod();
+
+/** @brief  Set sampling period of a rate class
+*   @param  rateClass Rate class [0..GPI_RATE_CLASSES-1]
+*   @param  us Time between each sample of GPI in rate class in microseconds [>0]
+*   @note   Poll thread wakes when any rate class with enabled GPI is due and each driver only accesses its device when
+*           it has due GPI, e.g. expanders read only ports holding due GPI. All classes default to POLL_SLEEP_US.
+*/
+void setGpiRatePeriod(uint8_t rateClass, uint32_t us);
+
+/** @brief  Get sampling period of a rate class
+*   @param  rateClass Rate class [0..GPI_RATE_CLASSES-1]
+*   @retval uint32_t Time between each sample in microseconds or 0 for invalid rate class
+*/
+uint32_t getGpiRatePeriod(uint8_t rateClass);
+
+/** @brief  Assign GPI to a sampling rate class
+*   @param  gpi Index of GPI
+*   @param  rateClass Rate class [0..GPI_RATE_CLASSES-1]
+*   @retval uint8_t 1 on success, 0 on failure, i.e. invalid index or rate class
+*   @note   GPI may be sampled more often than its class when its device is read for other GPI, e.g. same expander port
+*/
+uint8_t setGpiRate(uint32_t gpi, uint8_t rateClass);
+
+/** @brief  Get sampling rate class of GPI
+*   @param  gpi Index of GPI
+*   @retval uint8_t Rate class, GPI_RATE_DEFAULT for invalid index
+*/
+uint8_t getGpiRate(uint32_t gpi);
+
+/** @brief  Enable write-behind of outputs
+*   @param  enable 1 to defer output changes until next poll cycle, 0 to write each change immediately
+*   @note   With write-behind, setState only updates the driver's shadow and each device is written once per poll cycle,
+*           e.g. a single output latch write for all changed pins. Disabling write-behind flushes pending changes.
+*/
+void setGpiWriteBehind(uint8_t enable);
+
+/** @brief  Check if write-behind of outputs is enabled
+*   @retval uint8_t 1 if output changes are deferred until next poll cycle
+*/
+uint8_t getGpiWriteBehind();
+
+/** @brief  Write pending output changes of all drivers immediately
+*   @note   Use when an output change must take effect before the next poll cycle
+*/
+void flushGpi();
+
+/** @brief  Set scheduling policy of poll thread
+*   @param  policy Scheduling policy [SCHED_OTHER|SCHED_FIFO|SCHED_RR]
+*   @param  priority Scheduling priority, 0 for SCHED_OTHER
+*   @retval int 0 on success or error number, e.g. EPERM if real-time scheduling not permitted
+*   @note   Applied immediately if poll thread running and when poll thread is started
+*/
+int setPollScheduling(int policy, int priority);
+
+/** @brief  Register function to be called when value of an enabled GPI changes
+*   @param  callback Pointer to function to call with index of GPI and new value or NULL to disable
+*   @note   Called from poll thread which holds driver lock - callback must not block or add / remove drivers but may call setState, setDirection and setPull
+*/
+void setGpiChangeCallback(void(*callback)(uint32_t gpi, uint8_t value));
+
+/** @brief  Notify library that value of GPI has changed
+*   @param  gpi Index of GPI within global gpimap
+*   @param  value New value
+*   @note   Called by driver specific poll functions after updating GPI value
+*/
+void notifyGpiChange(uint32_t gpi, uint8_t value);
+
+/** @brief  Lock driver table against concurrent access by poll thread
+*   @note   Used by driver specific code whilst populating gpiDrivers and gpimap
+*/
+void lockGpiDrivers();
+
+/** @brief  Unlock driver table
+*/
+void unlockGpiDrivers();
+
 /** @brief  Enable / disable GPI
 *   @param  gpi Index of GPI
 *   @param  enable 1 to enable, 0 to disable
@@ -149,19 +273,21 @@ uint8_t getState(uint32_t gpi);
 */
 void setState(uint32_t gpi, uint8_t state);
 
-/** @brief  Instantiate an instance of a MCP23088 GPI interface driver providing 8 GPI pins
-*   @param  address I2C address
-*   @retval int Index of new GPI driver or -1 on failure
-*   @note   Index of GPI depends on order of instantiation
+/** @brief  Apply desired configuration to GPI of a driver as a difference from the device's current configuration
+*   @param  driver Index of driver
+*   @param  config Pointer to desired configuration
+*   @retval int Quantity of register writes performed or -1 on failure or if driver does not support configuration
+*   @note   Current direction and pull registers are read once in bulk and only registers that differ are written, so
+*           pins already configured, e.g. by a previous instance of the application, are not disturbed.
+*   @note   Must not be called with driver lock held
 */
-int addMcp23008GpiDevice(uint8_t I2C);
+int configureGpiDriver(uint32_t driver, const gpi_config_t* config);
 
-/** @brief  Instantiate an instance of a riban I2C GPI interface driver providing 50 GPI pins
-*   @param  address I2C address
-*   @retval int Index of new GPI driver or -1 on failure
-*   @note   Index of GPI depends on order of instantiation
+/** @brief  Get status of a GPI driver's device
+*   @param  driver Index of driver
+*   @retval uint8_t Status [GPI_STATUS_OK|GPI_STATUS_RETRY|GPI_STATUS_QUARANTINED|GPI_STATUS_INVALID]
 */
-int addRibanGpiDevice(uint8_t I2C);
+uint8_t getGpiDriverStatus(uint32_t driver);
 
 //-----------------------------------------------------------------------------
 #endif // ZYNGPI_H_INCLUDED
@@ -24,8 +24,58 @@
  */
 
 #include "i2c.h"
+#include "gpi.h" // Provides device status
+#include "stats.h" // Provides instrumentation
+#include <string.h> // Provides memcpy
+#include "timing.h" // Provides timestamps
 
-int i2cFd = -1; // File descriptor for I2C device
+/*  Define private functions */
+int i2cDevOpen();
+void i2cDevClose(int fd);
+int i2cDevTransfer(int fd, struct i2c_msg* msgs, uint8_t count);
+
+const i2c_transport_t i2cDevTransport = {i2cDevOpen, i2cDevClose, i2cDevTransfer};
+static const i2c_transport_t* i2cTransport = &i2cDevTransport; // Currently selected transport
+int i2cFd = -1; // Handle of open I2C transport
+uint8_t i2cAddress = 0; // Address of currently selected remote device
+
+int i2cTransfer(uint8_t address, struct i2c_msg* msgs, uint8_t count) {
+    if(i2cFd < 0)
+        return -1;
+    uint32_t bytes = 0;
+    for(uint8_t i = 0; i < count; ++i)
+        bytes += msgs[i].len;
+    uint64_t start = getTimeUs();
+    int result = i2cTransport->transfer(i2cFd, msgs, count);
+    if(result == 0 && getTimeUs() - start > I2C_TRANSACTION_BUDGET_US)
+        result = -1; // Device or bus too slow
+    statsRecordI2c(address, bytes, result != 0);
+    return result;
+}
+
+int i2cDevOpen() {
+    int fd = open("/dev/i2c-1", O_RDWR);
+    if(fd >= 0) {
+        // Bound time kernel waits for stuck bus (units of 10ms) and disable retries so that failures are reported promptly
+        ioctl(fd, I2C_TIMEOUT, 1);
+        ioctl(fd, I2C_RETRIES, 0);
+    }
+    return fd;
+}
+
+void i2cDevClose(int fd) {
+    close(fd);
+}
+
+int i2cDevTransfer(int fd, struct i2c_msg* msgs, uint8_t count) {
+    struct i2c_rdwr_ioctl_data data = {msgs, count};
+    return ioctl(fd, I2C_RDWR, &data) == count ? 0 : -1;
+}
+
+void i2cSetTransport(const i2c_transport_t* transport) {
+    i2cClose();
+    i2cTransport = transport ? transport : &i2cDevTransport;
+}
 
 int i2cGetFd() {
     return i2cFd;
@@ -34,33 +84,99 @@ int i2cGetFd() {
 int i2cOpen() {
     if(i2cFd >= 0)
         return i2cFd; // Already open
-    i2cFd = open("/dev/i2c-1", O_RDWR);
+    i2cFd = i2cTransport->open();
     return i2cFd;
 }
 
 void i2cClose() {
     if(i2cFd < 0)
         return;
-    close(i2cFd);
+    i2cTransport->close(i2cFd);
     i2cFd = -1;
 }
 
 int i2cSelectDevice(uint8_t address) {
     if(i2cFd < 0)
         return -1;
-    return ioctl(i2cFd, I2C_SLAVE, address);
+    i2cAddress = address;
+    return 0;
 }
 
-void i2cWriteByte(uint8_t value) {
-    if(i2cFd < 0)
-        return;
-    write(i2cFd, &value, 1);
+int i2cWriteByte(uint8_t value) {
+    struct i2c_msg msg = {i2cAddress, 0, 1, &value};
+    return i2cTransfer(i2cAddress, &msg, 1);
 }
 
-uint8_t i2cReadByte() {
-    if(i2cFd < 0)
-        return 0;
+int i2cReadByte() {
     uint8_t value = 0;
-    read(i2cFd, &value, 1);
+    struct i2c_msg msg = {i2cAddress, I2C_M_RD, 1, &value};
+    if(i2cTransfer(i2cAddress, &msg, 1) < 0)
+        return -1;
     return value;
 }
+
+int i2cRead(uint8_t address, uint8_t* buffer, uint8_t len) {
+    struct i2c_msg msg = {address, I2C_M_RD, len, buffer};
+    return i2cTransfer(address, &msg, 1);
+}
+
+int i2cWrite(uint8_t address, const uint8_t* buffer, uint8_t len) {
+    struct i2c_msg msg = {address, 0, len, (uint8_t*)buffer};
+    return i2cTransfer(address, &msg, 1);
+}
+
+int i2cReadRegisters(uint8_t address, uint8_t reg, uint8_t* buffer, uint8_t len) {
+    struct i2c_msg msgs[2] = {
+        {address, 0, 1, &reg},
+        {address, I2C_M_RD, len, buffer}
+    };
+    return i2cTransfer(address, msgs, 2);
+}
+
+int i2cWriteRead(uint8_t address, const uint8_t* command, uint8_t commandLen, uint8_t* buffer, uint8_t len) {
+    struct i2c_msg msgs[2] = {
+        {address, 0, commandLen, (uint8_t*)command},
+        {address, I2C_M_RD, len, buffer}
+    };
+    return i2cTransfer(address, msgs, 2);
+}
+
+int i2cWriteRegisters(uint8_t address, uint8_t reg, const uint8_t* buffer, uint8_t len) {
+    uint8_t data[256];
+    data[0] = reg;
+    memcpy(data + 1, buffer, len);
+    struct i2c_msg msg = {address, 0, len + 1, data};
+    return i2cTransfer(address, &msg, 1);
+}
+
+void i2cHealthReset(i2c_health_t* health) {
+    health->status = GPI_STATUS_OK;
+    health->failures = 0;
+    health->backoff = 0;
+    health->nextAttempt = 0;
+}
+
+uint8_t i2cHealthReady(i2c_health_t* health) {
+    return health->status == GPI_STATUS_OK || getTimeUs() >= health->nextAttempt;
+}
+
+uint8_t i2cHealthUpdate(i2c_health_t* health, int result) {
+    if(result >= 0) {
+        uint8_t recovered = (health->status != GPI_STATUS_OK);
+        i2cHealthReset(health);
+        return recovered;
+    }
+    if(health->failures < 255)
+        ++health->failures;
+    if(health->failures >= I2C_QUARANTINE_FAILURES) {
+        health->status = GPI_STATUS_QUARANTINED;
+        health->backoff = I2C_REPROBE_US;
+    } else {
+        health->status = GPI_STATUS_RETRY;
+        health->backoff = health->backoff ? health->backoff * 2 : I2C_BACKOFF_MIN_US;
+        if(health->backoff > I2C_BACKOFF_MAX_US)
+            health->backoff = I2C_BACKOFF_MAX_US;
+    }
+    health->nextAttempt = getTimeUs() + health->backoff;
+    return 0;
+}
@@ -26,18 +26,46 @@
 
 #include <stdint.h> //Provides fixed width integer definitions
 #include <sys/ioctl.h> //Provides device driver i/o control
+#include <linux/i2c.h> //Provides i2c message structure
 #include <linux/i2c-dev.h> //Provides userspace i2c interface
 #include <fcntl.h> //Provides file open
 #include <unistd.h> //Provides file close
 
+#define I2C_TRANSACTION_BUDGET_US   2000 // Transactions taking longer than this are treated as failed
+#define I2C_BACKOFF_MIN_US          10000 // Delay before first retry of failed device
+#define I2C_BACKOFF_MAX_US          1000000 // Maximum delay between retries of failed device
+#define I2C_QUARANTINE_FAILURES     5 // Quantity of consecutive failures before device is quarantined
+#define I2C_REPROBE_US              2000000 // Interval between probes of quarantined device
+
+//  Structure describing a pluggable I2C transport, e.g. Linux i2c-dev or simulator
+typedef struct i2c_transport_t {
+    int(*open)();           // Open bus, returning non-negative handle or negative error
+    void(*close)(int fd);   // Close bus
+    int(*transfer)(int fd, struct i2c_msg* msgs, uint8_t count); // Perform combined transaction, returning 0 on success or negative error
+} i2c_transport_t;
+
+//  Structure describing health of a remote I2C device
+typedef struct i2c_health_t {
+    uint8_t status;         // Device status [GPI_STATUS_OK|GPI_STATUS_RETRY|GPI_STATUS_QUARANTINED]
+    uint8_t failures;       // Quantity of consecutive failed transactions
+    uint32_t backoff;       // Current retry delay in microseconds
+    uint64_t nextAttempt;   // Time (us) before which device should not be accessed
+} i2c_health_t;
+
+/** @brief  Select I2C transport
+*   @param  transport Pointer to transport or NULL for Linux i2c-dev "/dev/i2c-1"
+*   @note   Closes currently open transport. Transport structure must remain valid whilst selected.
+*/
+void i2cSetTransport(const i2c_transport_t* transport);
+
 /** @brief  Get file descriptor of I2C device
 *   @retval int File descriptor or negative number if closed
 */
 int i2cGetFd();
 
-/** @brief  Open I2C device "/dev/i2c-1"
+/** @brief  Open I2C device, by default "/dev/i2c-1"
 *   @retval int File descriptor or negative error
-*   @note   Limited to RPI onboard I2C interface (>=V2)
+*   @note   Limited to RPI onboard I2C interface (>=V2) unless alternative transport selected
 */
 int i2cOpen();
 
@@ -45,7 +73,7 @@ int i2cOpen();
 */
 void i2cClose();
 
-/** @brief  Select remote I2C device to communicate with
+/** @brief  Select remote I2C device to communicate with using i2cWriteByte and i2cReadByte
 *   @param  address I2C address of remote device
 *   @retval int 0 on success or negative error
 */
@@ -53,19 +81,88 @@ int i2cSelectDevice(uint8_t address);
 
 /** @brief  Write a single byte to the selected remote I2C device
 *   @param  value Value to write
+*   @retval int 0 on success or negative error
 */
-void i2cWriteByte(uint8_t value);
+int i2cWriteByte(uint8_t value);
 
 /** @brief  Read a single byte from the selected remote I2C device
-*   @retval uint8_t Value read from remote I2C device
+*   @retval int Value read from remote I2C device [0..255] or negative error
+*/
+int i2cReadByte();
+
+/** @brief  Read bytes from remote I2C device without register addressing, e.g. quasi-bidirectional port expanders
+*   @param  address I2C address of remote device
+*   @param  buffer Pointer to buffer to populate
+*   @param  len Quantity of bytes to read
+*   @retval int 0 on success or negative error
+*/
+int i2cRead(uint8_t address, uint8_t* buffer, uint8_t len);
+
+/** @brief  Write bytes to remote I2C device without register addressing
+*   @param  address I2C address of remote device
+*   @param  buffer Pointer to values to write
+*   @param  len Quantity of bytes to write
+*   @retval int 0 on success or negative error
+*/
+int i2cWrite(uint8_t address, const uint8_t* buffer, uint8_t len);
+
+/** @brief  Perform a combined transaction of several messages separated by repeated start (I2C_RDWR)
+*   @param  address I2C address of remote device, used for instrumentation
+*   @param  msgs Pointer to array of messages
+*   @param  count Quantity of messages
+*   @retval int 0 on success or negative error
+*   @note   Transactions exceeding I2C_TRANSACTION_BUDGET_US are reported as failed
+*/
+int i2cTransfer(uint8_t address, struct i2c_msg* msgs, uint8_t count);
+
+/** @brief  Read consecutive registers from remote I2C device in a single combined transaction
+*   @param  address I2C address of remote device
+*   @param  reg Index of first register to read
+*   @param  buffer Pointer to buffer to populate
+*   @param  len Quantity of registers to read
+*   @retval int 0 on success or negative error
+*   @note   Transactions exceeding I2C_TRANSACTION_BUDGET_US are reported as failed
+*/
+int i2cReadRegisters(uint8_t address, uint8_t reg, uint8_t* buffer, uint8_t len);
+
+/** @brief  Write a command then read its response in a single combined transaction
+*   @param  address I2C address of remote device
+*   @param  command Pointer to command bytes to write
+*   @param  commandLen Quantity of command bytes
+*   @param  buffer Pointer to buffer to populate with response
+*   @param  len Quantity of bytes to read
+*   @retval int 0 on success or negative error
+*   @note   Transactions exceeding I2C_TRANSACTION_BUDGET_US are reported as failed
+*/
+int i2cWriteRead(uint8_t address, const uint8_t* command, uint8_t commandLen, uint8_t* buffer, uint8_t len);
+
+/** @brief  Write consecutive registers of remote I2C device in a single transaction
+*   @param  address I2C address of remote device
+*   @param  reg Index of first register to write
+*   @param  buffer Pointer to values to write
+*   @param  len Quantity of registers to write
+*   @retval int 0 on success or negative error
+*   @note   Transactions exceeding I2C_TRANSACTION_BUDGET_US are reported as failed
+*/
+int i2cWriteRegisters(uint8_t address, uint8_t reg, const uint8_t* buffer, uint8_t len);
+
+/** @brief  Reset device health to good
+*   @param  health Pointer to health structure
+*/
+void i2cHealthReset(i2c_health_t* health);
+
+/** @brief  Check if a device may be accessed
+*   @param  health Pointer to device health structure
+*   @retval uint8_t 1 if device is healthy or due a retry / re-probe, 0 if access is suspended
 */
-uint8_t i2cReadByte();
+uint8_t i2cHealthReady(i2c_health_t* health);
 
-/** @brief  Read a register from MCP23017 device
-*   @param  address I2C address of MCP23017 [0x20..0x27]
-*   @param  reg Index of register to read
-*   @retval uint8_t Value in register
+/** @brief  Update device health with result of a transaction
+*   @param  health Pointer to device health structure
+*   @param  result Result of transaction, 0 for success or negative error
+*   @retval uint8_t 1 if device has recovered from failure and should be re-initialised
+*   @note   Each failure doubles the retry delay up to I2C_BACKOFF_MAX_US. After I2C_QUARANTINE_FAILURES consecutive failures the device is quarantined and re-probed every I2C_REPROBE_US.
 */
-uint8_t i2cReadMcp23017Register(uint8_t address, uint8_t reg);
+uint8_t i2cHealthUpdate(i2c_health_t* health, int result);
 
 #endif // ZYNI2C_H_INCLUDED
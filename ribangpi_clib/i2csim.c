@@ -0,0 +1,495 @@
+/*
+ * ******************************************************************
+ * ZYNTHIAN PROJECT: I2C Library
+ *
+ * Userspace I2C transport simulating MCP23017, PCF8574, riban I2C GPI and ADS1115 devices
+ *
+ * Copyright (C) 2021 Brian Walton <riban@zynthian.org>
+ *
+ * ******************************************************************
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * For a full copy of the GNU General Public License see the LICENSE.txt file.
+ *
+ * ******************************************************************
+ */
+
+#include "i2csim.h"
+#include "mcp23017gpi.h" // Provides register definitions
+#include "ribani2cgpi.h" // Provides riban I2C GPI commands
+#include "ads1115gpi.h" // Provides ADS1115 registers
+#include <pthread.h> // Provides mutex
+#include <string.h> // Provides memset
+#include "timing.h" // Provides timestamps
+
+#define MCP23017SIM_REGS    0x16 // Quantity of registers
+#define SIM_REG(reg, port)  ((reg) * 2 + (port)) // Index of register in BANK=0 layout
+#define IOCON_BANK          0x80
+#define IOCON_SEQOP         0x20
+#define SIM_MCP23017        0 // Simulated device type: MCP23017
+#define SIM_PCF8574         1 // Simulated device type: PCF8574
+#define SIM_RIBAN           2 // Simulated device type: riban I2C GPI
+#define SIM_ADS1115         3 // Simulated device type: ADS1115
+#define SIM_MCP23S17        4 // Simulated device type: MCP23S17
+#define IOCON_HAEN          0x08
+#define MCP23S17_OPCODE     0x40 // SPI control byte: 0100 A2 A1 A0 R/W
+#define ADS1115SIM_CONFIG   0x8583 // ADS1115 configuration register power on value
+
+//  Structure describing a simulated device
+typedef struct simdevice_t {
+    uint8_t address;        // I2C address or I2CSIM_SPI_ADDRESS, 0 if slot unused
+    uint8_t type;           // Device type [SIM_MCP23017|SIM_PCF8574|SIM_RIBAN|SIM_ADS1115|SIM_MCP23S17]
+    uint8_t fault;          // 1 if device does not acknowledge
+    uint8_t pointer;        // Register address pointer as addressed by current BANK mode
+    uint8_t regs[MCP23017SIM_REGS]; // Registers in BANK=0 layout
+    uint64_t pins;          // External pin levels
+    uint8_t latch;          // PCF8574 output latch, pins written low are driven low
+    uint8_t sequence;       // riban change sequence number
+    uint64_t olat;          // riban output latch
+    uint64_t dir;           // riban direction (bit set: output)
+    uint64_t pull;          // riban pull-ups
+    uint16_t adcConfig;     // ADS1115 configuration register
+    int16_t analog[ADS1115_CHANNELS]; // ADS1115 input values
+} simdevice_t;
+
+static simdevice_t simDevices[I2CSIM_MAX_DEVICES];
+static i2csim_counters_t simCounters;
+static uint32_t simByteNs = I2CSIM_DEFAULT_BYTE_NS;
+static uint8_t simRealtime = 0;
+static pthread_mutex_t simMutex = PTHREAD_MUTEX_INITIALIZER;
+
+/*  Define private functions */
+int simOpen() {
+    return 0;
+}
+
+void simClose(int fd) {
+}
+
+simdevice_t* simFindDevice(uint8_t address) {
+    if(!address)
+        return NULL;
+    for(uint8_t i = 0; i < I2CSIM_MAX_DEVICES; ++i)
+        if(simDevices[i].address == address)
+            return &simDevices[i];
+    return NULL;
+}
+
+void simPowerOn(simdevice_t* dev) {
+    memset(dev->regs, 0, MCP23017SIM_REGS);
+    dev->latch = 0xFF; // PCF8574 powers on with all pins high (inputs)
+    dev->regs[SIM_REG(MCP23017_REG_IODIR, 0)] = 0xFF;
+    dev->regs[SIM_REG(MCP23017_REG_IODIR, 1)] = 0xFF;
+    dev->pointer = 0;
+    dev->sequence = 0;
+    dev->olat = 0;
+    dev->dir = 0;
+    dev->pull = 0;
+    dev->adcConfig = ADS1115SIM_CONFIG;
+}
+
+// Get index of register in BANK=0 layout from address in current BANK mode or -1 if not a register
+int simRegIndex(simdevice_t* dev, uint8_t addr) {
+    if(dev->regs[SIM_REG(MCP23017_REG_IOCON, 0)] & IOCON_BANK) {
+        uint8_t port = addr >> 4;
+        uint8_t reg = addr & 0x0F;
+        if(port > 1 || reg > MCP23017_REG_OLAT)
+            return -1;
+        return SIM_REG(reg, port);
+    }
+    return addr < MCP23017SIM_REGS ? addr : -1;
+}
+
+void simAdvancePointer(simdevice_t* dev) {
+    uint8_t iocon = dev->regs[SIM_REG(MCP23017_REG_IOCON, 0)];
+    if(iocon & IOCON_SEQOP) {
+        // Byte mode: BANK=0 toggles between A/B register pair, BANK=1 does not advance
+        if(!(iocon & IOCON_BANK))
+            dev->pointer ^= 1;
+        return;
+    }
+    ++dev->pointer;
+    if(iocon & IOCON_BANK) {
+        if((dev->pointer & 0x0F) > MCP23017_REG_OLAT)
+            dev->pointer = (dev->pointer & 0x10) ? 0 : 0x10;
+    } else if(dev->pointer >= MCP23017SIM_REGS) {
+        dev->pointer = 0;
+    }
+}
+
+// Get value presented by GPIO register of a port
+uint8_t simPortValue(simdevice_t* dev, uint8_t port) {
+    uint8_t iodir = dev->regs[SIM_REG(MCP23017_REG_IODIR, port)];
+    uint8_t inputs = ((dev->pins >> (port * 8)) ^ dev->regs[SIM_REG(MCP23017_REG_IPOL, port)]) & iodir;
+    return inputs | (dev->regs[SIM_REG(MCP23017_REG_OLAT, port)] & ~iodir);
+}
+
+uint8_t simRead(simdevice_t* dev) {
+    int index = simRegIndex(dev, dev->pointer);
+    simAdvancePointer(dev);
+    if(index < 0)
+        return 0;
+    uint8_t reg = index >> 1;
+    uint8_t port = index & 1;
+    if(reg == MCP23017_REG_GPIO || reg == MCP23017_REG_INTCAP) {
+        uint8_t value = (reg == MCP23017_REG_GPIO) ? simPortValue(dev, port) : dev->regs[index];
+        dev->regs[SIM_REG(MCP23017_REG_INTF, port)] = 0; // Reading GPIO or INTCAP clears interrupt
+        return value;
+    }
+    return dev->regs[index];
+}
+
+void simWrite(simdevice_t* dev, uint8_t value) {
+    int index = simRegIndex(dev, dev->pointer);
+    simAdvancePointer(dev);
+    if(index < 0)
+        return;
+    uint8_t reg = index >> 1;
+    uint8_t port = index & 1;
+    switch(reg) {
+        case MCP23017_REG_IOCON:
+            // Single register appears at both addresses
+            dev->regs[SIM_REG(MCP23017_REG_IOCON, 0)] = value & 0xFE;
+            dev->regs[SIM_REG(MCP23017_REG_IOCON, 1)] = value & 0xFE;
+            break;
+        case MCP23017_REG_GPIO:
+            dev->regs[SIM_REG(MCP23017_REG_OLAT, port)] = value; // Write to GPIO modifies output latch
+            break;
+        case MCP23017_REG_INTF:
+        case MCP23017_REG_INTCAP:
+            break; // Read only
+        default:
+            dev->regs[index] = value;
+    }
+}
+
+// Get levels reported by riban device: external levels of inputs, latch of outputs
+uint64_t simRibanLevels(simdevice_t* dev) {
+    return ((dev->pins & ~dev->dir) | (dev->olat & dev->dir)) & RIBAN_I2C_BITMAP_MASK;
+}
+
+// Apply change to riban device, advancing sequence if reported levels change
+void simRibanUpdate(simdevice_t* dev, uint64_t previous) {
+    if(simRibanLevels(dev) != previous)
+        ++dev->sequence;
+}
+
+void simRibanWrite(simdevice_t* dev, const uint8_t* buffer, uint16_t len) {
+    dev->pointer = buffer[0];
+    if(dev->pointer == RIBAN_I2C_CMD_SINCE || len < 1 + 2 * RIBAN_I2C_BITMAP_BYTES)
+        return; // Interrupt line is not modelled so sequence N is ignored
+    uint64_t mask = 0, values = 0;
+    for(uint8_t i = 0; i < RIBAN_I2C_BITMAP_BYTES; ++i) {
+        mask |= (uint64_t)buffer[1 + i] << (i * 8);
+        values |= (uint64_t)buffer[1 + RIBAN_I2C_BITMAP_BYTES + i] << (i * 8);
+    }
+    uint64_t previous = simRibanLevels(dev);
+    uint64_t* target;
+    switch(dev->pointer) {
+        case RIBAN_I2C_CMD_OUTPUT: target = &dev->olat; break;
+        case RIBAN_I2C_CMD_DIRECTION: target = &dev->dir; break;
+        case RIBAN_I2C_CMD_PULLUP: target = &dev->pull; break;
+        default: return;
+    }
+    *target = (*target & ~mask) | (values & mask);
+    simRibanUpdate(dev, previous);
+}
+
+void simRibanRead(simdevice_t* dev, uint8_t* buffer, uint16_t len) {
+    // Levels are captured at start of read so that response is consistent
+    uint64_t levels = simRibanLevels(dev);
+    for(uint16_t j = 0; j < len; ++j) {
+        if(dev->pointer != RIBAN_I2C_CMD_LEVELS && dev->pointer != RIBAN_I2C_CMD_SINCE)
+            buffer[j] = 0;
+        else if(j == 0)
+            buffer[j] = dev->sequence;
+        else if(j <= RIBAN_I2C_BITMAP_BYTES)
+            buffer[j] = levels >> ((j - 1) * 8);
+        else
+            buffer[j] = 0;
+    }
+}
+
+// Get ADS1115 register addressed by pointer
+uint16_t simAdcRegister(simdevice_t* dev) {
+    if(dev->pointer == ADS1115_REG_CONFIG)
+        return dev->adcConfig;
+    if(dev->pointer != ADS1115_REG_CONVERSION)
+        return 0;
+    uint8_t mux = (dev->adcConfig >> 12) & 0x07;
+    return mux >= 4 ? (uint16_t)dev->analog[mux - 4] : 0; // Only single-ended inputs are modelled
+}
+
+void simSpin(uint64_t ns) {
+    uint64_t end = getCounterNs() + ns;
+    while(getCounterNs() < end)
+        ;
+}
+
+int simTransfer(int fd, struct i2c_msg* msgs, uint8_t count) {
+    int result = 0;
+    uint32_t bytes = 0;
+    pthread_mutex_lock(&simMutex);
+    for(uint8_t i = 0; i < count; ++i) {
+        ++bytes; // Address byte
+        simdevice_t* dev = simFindDevice(msgs[i].addr);
+        if(!dev || dev->fault) {
+            ++simCounters.naks;
+            result = -1; // Not acknowledged - transaction aborted
+            break;
+        }
+        bytes += msgs[i].len;
+        if(dev->type == SIM_PCF8574) {
+            // Quasi-bidirectional port without registers
+            for(uint16_t j = 0; j < msgs[i].len; ++j) {
+                if(msgs[i].flags & I2C_M_RD)
+                    msgs[i].buf[j] = dev->pins & dev->latch;
+                else
+                    dev->latch = msgs[i].buf[j];
+            }
+        } else if(dev->type == SIM_RIBAN) {
+            if(msgs[i].flags & I2C_M_RD)
+                simRibanRead(dev, msgs[i].buf, msgs[i].len);
+            else if(msgs[i].len)
+                simRibanWrite(dev, msgs[i].buf, msgs[i].len);
+        } else if(dev->type == SIM_ADS1115) {
+            if(msgs[i].flags & I2C_M_RD) {
+                uint16_t value = simAdcRegister(dev);
+                for(uint16_t j = 0; j < msgs[i].len; ++j)
+                    msgs[i].buf[j] = (j & 1) ? value & 0xFF : value >> 8;
+            } else if(msgs[i].len) {
+                dev->pointer = msgs[i].buf[0] & 0x03;
+                if(dev->pointer == ADS1115_REG_CONFIG && msgs[i].len >= 3)
+                    dev->adcConfig = msgs[i].buf[1] << 8 | msgs[i].buf[2];
+            }
+        } else if(msgs[i].flags & I2C_M_RD) {
+            for(uint16_t j = 0; j < msgs[i].len; ++j)
+                msgs[i].buf[j] = simRead(dev);
+        } else if(msgs[i].len) {
+            dev->pointer = msgs[i].buf[0]; // First byte written sets address pointer
+            for(uint16_t j = 1; j < msgs[i].len; ++j)
+                simWrite(dev, msgs[i].buf[j]);
+        }
+    }
+    uint64_t ns = (uint64_t)bytes * simByteNs;
+    ++simCounters.transactions;
+    simCounters.bytes += bytes;
+    simCounters.busNs += ns;
+    uint8_t realtime = simRealtime;
+    pthread_mutex_unlock(&simMutex);
+    if(realtime)
+        simSpin(ns);
+    return result;
+}
+
+const i2c_transport_t i2cSimTransport = {simOpen, simClose, simTransfer};
+
+int simSpiOpen(uint8_t cs, uint32_t speed) {
+    return cs; // Handle is chip select
+}
+
+// Check if MCP23S17 responds to opcode: hardware address is ignored until IOCON.HAEN is set
+uint8_t simSpiSelected(simdevice_t* dev, uint8_t cs, uint8_t opcode) {
+    if(dev->type != SIM_MCP23S17 || dev->fault || (dev->address & 0x78) != (I2CSIM_SPI_ADDRESS(cs, 0) & 0x78))
+        return 0;
+    if((opcode & 0xF0) != MCP23S17_OPCODE)
+        return 0;
+    if(!(dev->regs[SIM_REG(MCP23017_REG_IOCON, 0)] & IOCON_HAEN))
+        return 1;
+    return ((opcode >> 1) & 0x07) == (dev->address & 0x07);
+}
+
+int simSpiTransfer(int fd, struct spi_ioc_transfer* xfers, uint8_t count) {
+    uint32_t bytes = 0;
+    pthread_mutex_lock(&simMutex);
+    for(uint8_t i = 0; i < count; ++i) {
+        const uint8_t* tx = (const uint8_t*)(uintptr_t)xfers[i].tx_buf;
+        uint8_t* rx = (uint8_t*)(uintptr_t)xfers[i].rx_buf;
+        uint32_t len = xfers[i].len;
+        bytes += len;
+        if(rx)
+            memset(rx, 0xFF, len); // Undriven MISO reads high
+        if(!tx || len < 2)
+            continue;
+        uint8_t responded = 0;
+        for(uint8_t d = 0; d < I2CSIM_MAX_DEVICES; ++d) {
+            simdevice_t* dev = &simDevices[d];
+            if(!dev->address || !simSpiSelected(dev, fd, tx[0]))
+                continue;
+            // Every selected device acts on transfer, e.g. writes before HAEN, but only first drives MISO
+            dev->pointer = tx[1];
+            for(uint32_t j = 2; j < len; ++j) {
+                if(tx[0] & 1) {
+                    uint8_t value = simRead(dev);
+                    if(rx && !responded)
+                        rx[j] = value;
+                } else {
+                    simWrite(dev, tx[j]);
+                }
+            }
+            responded = 1;
+        }
+        if(!responded)
+            ++simCounters.naks;
+    }
+    uint64_t ns = (uint64_t)bytes * I2CSIM_SPI_BYTE_NS;
+    ++simCounters.transactions;
+    simCounters.bytes += bytes;
+    simCounters.busNs += ns;
+    uint8_t realtime = simRealtime;
+    pthread_mutex_unlock(&simMutex);
+    if(realtime)
+        simSpin(ns);
+    return 0;
+}
+
+const spi_transport_t spiSimTransport = {simSpiOpen, simClose, simSpiTransfer};
+
+void i2cSimReset() {
+    pthread_mutex_lock(&simMutex);
+    memset(simDevices, 0, sizeof(simDevices));
+    memset(&simCounters, 0, sizeof(simCounters));
+    simByteNs = I2CSIM_DEFAULT_BYTE_NS;
+    simRealtime = 0;
+    pthread_mutex_unlock(&simMutex);
+}
+
+int simAddDevice(uint8_t address, uint8_t type) {
+    int result = -1;
+    pthread_mutex_lock(&simMutex);
+    if(address && !simFindDevice(address)) {
+        for(uint8_t i = 0; i < I2CSIM_MAX_DEVICES; ++i) {
+            if(simDevices[i].address)
+                continue;
+            memset(&simDevices[i], 0, sizeof(simdevice_t));
+            simDevices[i].address = address;
+            simDevices[i].type = type;
+            simPowerOn(&simDevices[i]);
+            result = 0;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&simMutex);
+    return result;
+}
+
+int i2cSimAddMcp23017(uint8_t address) {
+    return simAddDevice(address, SIM_MCP23017);
+}
+
+int i2cSimAddPcf8574(uint8_t address) {
+    return simAddDevice(address, SIM_PCF8574);
+}
+
+int i2cSimAddRiban(uint8_t address) {
+    return simAddDevice(address, SIM_RIBAN);
+}
+
+int i2cSimAddMcp23S17(uint8_t cs, uint8_t hw) {
+    if(cs >= SPI_MAX_CS || hw > 7)
+        return -1;
+    return simAddDevice(I2CSIM_SPI_ADDRESS(cs, hw), SIM_MCP23S17);
+}
+
+int i2cSimAddAds1115(uint8_t address) {
+    return simAddDevice(address, SIM_ADS1115);
+}
+
+void i2cSimSetAnalog(uint8_t address, uint8_t channel, int16_t value) {
+    pthread_mutex_lock(&simMutex);
+    simdevice_t* dev = simFindDevice(address);
+    if(dev && channel < ADS1115_CHANNELS)
+        dev->analog[channel] = value;
+    pthread_mutex_unlock(&simMutex);
+}
+
+void i2cSimSetFault(uint8_t address, uint8_t fault, uint8_t powerCycle) {
+    pthread_mutex_lock(&simMutex);
+    simdevice_t* dev = simFindDevice(address);
+    if(dev) {
+        dev->fault = fault;
+        if(powerCycle)
+            simPowerOn(dev);
+    }
+    pthread_mutex_unlock(&simMutex);
+}
+
+void i2cSimSetInputs(uint8_t address, uint64_t levels) {
+    pthread_mutex_lock(&simMutex);
+    simdevice_t* dev = simFindDevice(address);
+    if(dev && dev->type == SIM_RIBAN) {
+        uint64_t previous = simRibanLevels(dev);
+        dev->pins = levels;
+        simRibanUpdate(dev, previous);
+    } else if(dev) {
+        uint16_t previous = dev->pins;
+        dev->pins = levels;
+        for(uint8_t port = 0; port < 2; ++port) {
+            uint8_t level = levels >> (port * 8);
+            uint8_t enabled = dev->regs[SIM_REG(MCP23017_REG_GPINTEN, port)] & dev->regs[SIM_REG(MCP23017_REG_IODIR, port)];
+            uint8_t intcon = dev->regs[SIM_REG(MCP23017_REG_INTCON, port)];
+            // INTCON bit set: compare to DEFVAL, clear: compare to previous level
+            uint8_t compare = (dev->regs[SIM_REG(MCP23017_REG_DEFVAL, port)] & intcon) | ((previous >> (port * 8)) & ~intcon);
+            uint8_t trigger = (level ^ compare) & enabled;
+            if(trigger && !dev->regs[SIM_REG(MCP23017_REG_INTF, port)]) {
+                dev->regs[SIM_REG(MCP23017_REG_INTF, port)] = trigger;
+                dev->regs[SIM_REG(MCP23017_REG_INTCAP, port)] = simPortValue(dev, port);
+            }
+        }
+    }
+    pthread_mutex_unlock(&simMutex);
+}
+
+uint64_t i2cSimGetOutputs(uint8_t address) {
+    uint64_t outputs = 0;
+    pthread_mutex_lock(&simMutex);
+    simdevice_t* dev = simFindDevice(address);
+    if(dev && dev->type == SIM_RIBAN) {
+        outputs = dev->olat & dev->dir;
+    } else if(dev && dev->type == SIM_PCF8574) {
+        outputs = dev->latch;
+    } else if(dev) {
+        for(uint8_t port = 0; port < 2; ++port)
+            outputs |= (dev->regs[SIM_REG(MCP23017_REG_OLAT, port)] & ~dev->regs[SIM_REG(MCP23017_REG_IODIR, port)]) << (port * 8);
+    }
+    pthread_mutex_unlock(&simMutex);
+    return outputs;
+}
+
+int i2cSimGetRegister(uint8_t address, uint8_t reg) {
+    int value = -1;
+    pthread_mutex_lock(&simMutex);
+    simdevice_t* dev = simFindDevice(address);
+    if(dev && (dev->type == SIM_MCP23017 || dev->type == SIM_MCP23S17) && reg < MCP23017SIM_REGS)
+        value = (reg >> 1 == MCP23017_REG_GPIO) ? simPortValue(dev, reg & 1) : dev->regs[reg];
+    pthread_mutex_unlock(&simMutex);
+    return value;
+}
+
+void i2cSimSetByteTime(uint32_t ns, uint8_t realtime) {
+    pthread_mutex_lock(&simMutex);
+    simByteNs = ns;
+    simRealtime = realtime;
+    pthread_mutex_unlock(&simMutex);
+}
+
+void i2cSimGetCounters(i2csim_counters_t* counters) {
+    pthread_mutex_lock(&simMutex);
+    *counters = simCounters;
+    pthread_mutex_unlock(&simMutex);
+}
+
+void i2cSimResetCounters() {
+    pthread_mutex_lock(&simMutex);
+    memset(&simCounters, 0, sizeof(simCounters));
+    pthread_mutex_unlock(&simMutex);
+}
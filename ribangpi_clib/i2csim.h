@@ -0,0 +1,162 @@
+/*
+ * ******************************************************************
+ * ZYNTHIAN PROJECT: I2C Library
+ *
+ * Userspace I2C transport simulating MCP23017, PCF8574, riban I2C GPI and ADS1115 devices
+ *
+ * Copyright (C) 2021 Brian Walton <riban@zynthian.org>
+ *
+ * ******************************************************************
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * For a full copy of the GNU General Public License see the LICENSE.txt file.
+ *
+ * ******************************************************************
+ */
+
+/*  Simulator transport allows I2C device drivers to run without hardware and counts bus cost.
+    Select with i2cSetTransport(&i2cSimTransport) before adding I2C GPI devices.
+
+    Each simulated MCP23017 models:
+        All registers with IOCON.BANK=0 and IOCON.BANK=1 addressing
+        Sequential (SEQOP=0) and byte mode (SEQOP=1) address pointer
+        Input polarity, output latch and direction
+        Interrupt on change / compare to DEFVAL with INTF and INTCAP, cleared by reading GPIO or INTCAP
+    Simplifications:
+        In BANK=1 sequential mode the address pointer advances from 0x0A to 0x10 and from 0x1A to 0x00
+        Pull-ups do not affect input level - levels are set by i2cSimSetInputs
+        Interrupt output pin is not modelled - use INTF
+
+    Each simulated PCF8574 models a quasi-bidirectional port without registers: reads return external levels AND output latch.
+
+    Each simulated riban I2C GPI device models the bulk protocol (ribani2cgpi.h): levels, change sequence and masked writes of
+    output, direction and pull-up. Pull-ups do not affect input level and the interrupt line is not modelled.
+
+    Each simulated ADS1115 models the address pointer, configuration register and conversion register which immediately
+    holds the value of the single-ended input selected by the multiplexer, set by i2cSimSetAnalog.
+
+    Each simulated MCP23S17 models the MCP23017 registers behind the SPI opcode. Until IOCON.HAEN is set the device
+    responds to any hardware address on its chip select. Select with spiSetTransport(&spiSimTransport) and identify
+    simulated MCP23S17 in other calls by I2CSIM_SPI_ADDRESS(cs, hw). SPI has no acknowledge so an absent device reads 0xFF.
+
+    Bus cost is counted as bytes on the bus, including the address byte of each I2C message and SPI opcode.
+    Each byte costs a configurable time which may optionally be spent busy-waiting to emulate bus latency.
+*/
+
+#ifndef ZYNI2CSIM_H_INCLUDED
+#define ZYNI2CSIM_H_INCLUDED
+
+#include "i2c.h"
+#include "spi.h"
+
+#define I2CSIM_MAX_DEVICES      8 // Maximum quantity of simulated devices
+#define I2CSIM_DEFAULT_BYTE_NS  90000 // Time per byte: 9 clocks at 100kHz
+#define I2CSIM_SPI_BYTE_NS      800 // Time per SPI byte: 8 clocks at 10MHz
+#define I2CSIM_SPI_ADDRESS(cs, hw) (0x80 | (cs) << 3 | (hw)) // Simulator address of SPI device, outside I2C address range
+
+//  Structure describing simulated bus usage
+typedef struct i2csim_counters_t {
+    uint32_t transactions;  // Quantity of combined transactions
+    uint32_t bytes;         // Quantity of bytes on bus including address bytes
+    uint64_t busNs;         // Simulated bus time in nanoseconds
+    uint32_t naks;          // Quantity of transactions not acknowledged, i.e. absent or faulty device
+} i2csim_counters_t;
+
+extern const i2c_transport_t i2cSimTransport; // Simulator transport to pass to i2cSetTransport
+extern const spi_transport_t spiSimTransport; // Simulator transport to pass to spiSetTransport
+
+/** @brief  Remove all simulated devices and reset counters and timing
+*/
+void i2cSimReset();
+
+/** @brief  Add a simulated MCP23017 in power on state
+*   @param  address I2C address
+*   @retval int 0 on success, -1 if address already used or too many devices
+*/
+int i2cSimAddMcp23017(uint8_t address);
+
+/** @brief  Add a simulated PCF8574 in power on state
+*   @param  address I2C address
+*   @retval int 0 on success, -1 if address already used or too many devices
+*   @note   Pins read low if driven low by output latch or by i2cSimSetInputs
+*/
+int i2cSimAddPcf8574(uint8_t address);
+
+/** @brief  Add a simulated riban I2C GPI device in power on state
+*   @param  address I2C address
+*   @retval int 0 on success, -1 if address already used or too many devices
+*/
+int i2cSimAddRiban(uint8_t address);
+
+/** @brief  Add a simulated MCP23S17 in power on state
+*   @param  cs SPI chip select [0..SPI_MAX_CS-1]
+*   @param  hw Hardware address set by A2..A0 pins [0..7]
+*   @retval int 0 on success, -1 if address already used or too many devices
+*/
+int i2cSimAddMcp23S17(uint8_t cs, uint8_t hw);
+
+/** @brief  Add a simulated ADS1115 in power on state
+*   @param  address I2C address
+*   @retval int 0 on success, -1 if address already used or too many devices
+*/
+int i2cSimAddAds1115(uint8_t address);
+
+/** @brief  Set value of a simulated ADS1115 input
+*   @param  address I2C address
+*   @param  channel Single-ended input [0..3]
+*   @param  value Conversion result
+*/
+void i2cSimSetAnalog(uint8_t address, uint8_t channel, int16_t value);
+
+/** @brief  Set simulated device fault state
+*   @param  address I2C address
+*   @param  fault 1 to make device stop acknowledging transactions, 0 to restore
+*   @param  powerCycle 1 to reset device registers to power on state, e.g. when restoring after fault
+*/
+void i2cSimSetFault(uint8_t address, uint8_t fault, uint8_t powerCycle);
+
+/** @brief  Set external levels of simulated device pins
+*   @param  address I2C address
+*   @param  levels Pin levels, bit 0..7: port A, bit 8..15: port B (riban: bit 0..49)
+*   @note   Triggers interrupt capture as configured by device registers
+*/
+void i2cSimSetInputs(uint8_t address, uint64_t levels);
+
+/** @brief  Get levels of simulated device output pins
+*   @param  address I2C address
+*   @retval uint64_t Output latch of pins configured as output, inputs read as 0 (PCF8574: output latch)
+*/
+uint64_t i2cSimGetOutputs(uint8_t address);
+
+/** @brief  Get value of simulated device register without bus access
+*   @param  address I2C address
+*   @param  reg Register address using IOCON.BANK=0 layout [0x00..0x15]
+*   @retval int Register value or -1 if no such device or register
+*/
+int i2cSimGetRegister(uint8_t address, uint8_t reg);
+
+/** @brief  Configure simulated bus timing
+*   @param  ns Time per byte in nanoseconds
+*   @param  realtime 1 to busy-wait for simulated bus time during each transaction
+*/
+void i2cSimSetByteTime(uint32_t ns, uint8_t realtime);
+
+/** @brief  Get simulated bus usage counters
+*   @param  counters Pointer to structure to populate
+*/
+void i2cSimGetCounters(i2csim_counters_t* counters);
+
+/** @brief  Reset simulated bus usage counters
+*/
+void i2cSimResetCounters();
+
+#endif // ZYNI2CSIM_H_INCLUDED
@@ -25,7 +25,7 @@
 #ifndef ZYNMCP23017GPI_H_INCLUDED
 #define ZYNMCP23017GPI_H_INCLUDED
 
-#include "gpi.h"
+#include "expandergpi.h" // Provides addMcp23017GpiDevice
 
 /*  MCP21017 Registers
     IOCON.BANK=1    IOCON.BANK=0    Register
@@ -70,11 +70,14 @@
     Power on:
         All GPI are non-inverted inputs
         Bank=0
+    The driver is provided by the expander engine (expandergpi.h) which configures IOCON.BANK=0 so that port A and B registers
+    are adjacent and both ports are read in a single burst.
 */
 
 /*  Ensure GPI driver type is unique */
 #define GPI_DRIVER_MCP23017     3
 
+//  Register addresses with IOCON.BANK=1, OR with port << 4. MCP23008 has a single port at these addresses.
 #define MCP23017_REG_IODIR      0x0
 #define MCP23017_REG_IPOL       0x1
 #define MCP23017_REG_GPINTEN    0x2
@@ -86,37 +89,7 @@
 #define MCP23017_REG_INTCAP     0x8
 #define MCP23017_REG_GPIO       0x9
 #define MCP23017_REG_OLAT       0xA
+#define MCP23017_REG_IOCON_BANK0 0x0A // Address of IOCON when IOCON.BANK=0, e.g. after power on
 
-/** @brief  Instantiate an instance of a MCP23017 GPI interface driver providing 16 GPI pins
-*   @param  address I2C address
-*   @param  interrupt GPI pin acting as interrupt signal
-*   @retval int Index of new GPI driver or -1 on failure
-*   @note   Index of GPI depends on order of instantiation
-*/
-int addMcp23017GpiDevice(uint8_t address, uint8_t interrupt);
-
-/** @brief  Set GPI state
-*   @param  gpi Index of GPI within global gpimap
-*   @param  state New GPI state
-*/
-void setMcp23017GpiState(uint32_t gpi, uint8_t state);
-
-/** @brief  Set GPI direction
-*   @param  gpi Index of GPI within global gpimap
-*   @param  dir Direction [0:Input, 1:Output]
-*/
-void setMcp23017GpiDirection(uint32_t gpi, uint8_t dir);
-
-/** @brief  Set GPI pull up resistors
-*   @param  gpi Index of GPI within global gpimap
-*   @param  mode Pull mode [0:Disabled, 1:Pull-up enabled]
-*/
-void setMcp23017GpiPull(uint32_t gpi, uint8_t mode);
-
-/** @brief  Poll for change of state
-*   @param  gpi Index of GPI within global gpimap
-*   @retval uint8_t 1 if any GPI within driver has changed else 0
-*/
-uint8_t pollMcp23017Gpi(uint32_t driver);
 //-----------------------------------------------------------------------------
 #endif // ZYNMCP23017GPI_H_INCLUDED
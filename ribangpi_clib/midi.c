@@ -0,0 +1,227 @@
+/*
+ * ******************************************************************
+ * ZYNTHIAN PROJECT: GPI Library
+ *
+ * Bridge from GPI to MIDI output for Zynthian
+ *
+ * Copyright (C) 2021 Brian Walton <riban@zynthian.org>
+ *
+ * ******************************************************************
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * For a full copy of the GNU General Public License see the LICENSE.txt file.
+ *
+ * ******************************************************************
+ */
+
+#include "midi.h"
+#include "stats.h" // Provides instrumentation
+#include <pthread.h> // Provides mutex
+#include <string.h> // Provides memset
+#include <errno.h> // Provides errno
+
+#define MIDI_NOTE_ON    0x90
+#define MIDI_CC         0xB0
+
+//  Structure describing mapping of a GPI to MIDI
+typedef struct midi_map_t {
+    uint8_t type;           // Mapping type [MIDI_MAP_NONE|MIDI_MAP_NOTE|MIDI_MAP_CC|MIDI_MAP_ENCODER|MIDI_MAP_ENCODER_REL|MIDI_MAP_ENCODER_B]
+    uint8_t status;         // MIDI status byte including channel
+    uint8_t number;         // Note or controller number
+    uint8_t value;          // Velocity or value sent when active, current value of absolute encoder
+    uint8_t activeLow;      // 1 if GPI is active when low
+    uint8_t quad;           // Encoder: last input levels (bit 1: A, bit 0: B)
+    int8_t steps;           // Encoder: quadrature transitions since last detent
+    uint16_t partner;       // Encoder: index of other input
+} midi_map_t;
+
+static pthread_mutex_t midiMutex = PTHREAD_MUTEX_INITIALIZER; // Protects maps and batch
+static midi_map_t midiMaps[MAX_GPI]; // Mappings indexed by GPI
+static uint8_t midiBuffer[MIDI_BUFFER_SIZE]; // Batch of messages for current poll cycle
+static uint32_t midiLength = 0; // Quantity of bytes in batch
+static uint8_t midiRunningStatus = 0; // Status of last message in batch, 0 if none
+static int midiFd = -1; // Output file descriptor
+
+// Direction of quadrature transition indexed by previous << 2 | current levels, +1 when A leads B
+static const int8_t quadTable[16] = {0, -1, 1, 0, 1, 0, 0, -1, -1, 0, 0, 1, 0, 1, -1, 0};
+
+/*  Define private functions */
+// Write batch to output - call with midiMutex locked
+void midiWrite() {
+    uint32_t written = 0;
+    while(midiFd >= 0 && written < midiLength) {
+        ssize_t result = write(midiFd, midiBuffer + written, midiLength - written);
+        if(result < 0 && errno == EINTR)
+            continue;
+        if(result <= 0)
+            break; // Output full or closed - drop remainder, next batch starts with status byte
+        written += result;
+    }
+    if(midiLength)
+        statsRecordMidi(written, midiLength - written);
+    midiLength = 0;
+    midiRunningStatus = 0;
+}
+
+// Append message to batch using running status - call with midiMutex locked
+void midiAppend(uint8_t status, uint8_t data1, uint8_t data2) {
+    if(midiFd < 0)
+        return;
+    if(midiLength + 3 > MIDI_BUFFER_SIZE)
+        midiWrite();
+    if(status != midiRunningStatus) {
+        midiBuffer[midiLength++] = status;
+        midiRunningStatus = status;
+    }
+    midiBuffer[midiLength++] = data1;
+    midiBuffer[midiLength++] = data2;
+}
+
+// Remove mapping and that of encoder partner - call with midiMutex locked
+void midiUnmap(uint32_t gpi) {
+    midi_map_t* map = &midiMaps[gpi];
+    if(map->type >= MIDI_MAP_ENCODER)
+        __atomic_store_n(&midiMaps[map->partner].type, MIDI_MAP_NONE, __ATOMIC_RELAXED);
+    __atomic_store_n(&map->type, MIDI_MAP_NONE, __ATOMIC_RELAXED);
+}
+
+// Accumulate encoder transition, sending controller at each detent - call with midiMutex locked
+void midiEncoderChange(midi_map_t* encoder, uint8_t quad) {
+    encoder->steps += quadTable[encoder->quad << 2 | quad];
+    encoder->quad = quad;
+    int8_t delta = 0;
+    if(encoder->steps >= MIDI_ENCODER_STEPS)
+        delta = 1;
+    else if(encoder->steps <= -MIDI_ENCODER_STEPS)
+        delta = -1;
+    if(!delta)
+        return;
+    encoder->steps -= delta * MIDI_ENCODER_STEPS;
+    if(encoder->type == MIDI_MAP_ENCODER_REL) {
+        midiAppend(encoder->status, encoder->number, 64 + delta);
+        return;
+    }
+    int value = encoder->value + delta;
+    if(value < 0 || value > 127)
+        return;
+    encoder->value = value;
+    midiAppend(encoder->status, encoder->number, value);
+}
+
+void setMidiOutput(int fd) {
+    pthread_mutex_lock(&midiMutex);
+    midiLength = 0; // Discard messages batched for previous output
+    midiRunningStatus = 0;
+    midiFd = fd < 0 ? -1 : fd;
+    pthread_mutex_unlock(&midiMutex);
+}
+
+int getMidiOutput() {
+    pthread_mutex_lock(&midiMutex);
+    int fd = midiFd;
+    pthread_mutex_unlock(&midiMutex);
+    return fd;
+}
+
+int addMidiMap(uint32_t gpi, uint8_t type, uint8_t channel, uint8_t number, uint8_t value, uint8_t activeLow) {
+    if(gpi >= MAX_GPI || (type != MIDI_MAP_NOTE && type != MIDI_MAP_CC) || channel > 15 || number > 127 || value > 127)
+        return -1;
+    pthread_mutex_lock(&midiMutex);
+    midiUnmap(gpi);
+    midi_map_t* map = &midiMaps[gpi];
+    memset(map, 0, sizeof(midi_map_t));
+    map->status = (type == MIDI_MAP_NOTE ? MIDI_NOTE_ON : MIDI_CC) | channel;
+    map->number = number;
+    map->value = value;
+    map->activeLow = activeLow ? 1 : 0;
+    __atomic_store_n(&map->type, type, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&midiMutex);
+    return 0;
+}
+
+int addMidiEncoderMap(uint32_t gpiA, uint32_t gpiB, uint8_t relative, uint8_t channel, uint8_t cc, uint8_t value) {
+    if(gpiA >= MAX_GPI || gpiB >= MAX_GPI || gpiA == gpiB || channel > 15 || cc > 127 || value > 127)
+        return -1;
+    pthread_mutex_lock(&midiMutex);
+    midiUnmap(gpiA);
+    midiUnmap(gpiB);
+    midi_map_t* encoder = &midiMaps[gpiA];
+    memset(encoder, 0, sizeof(midi_map_t));
+    encoder->status = MIDI_CC | channel;
+    encoder->number = cc;
+    encoder->value = value;
+    encoder->quad = getState(gpiA) << 1 | getState(gpiB);
+    encoder->partner = gpiB;
+    memset(&midiMaps[gpiB], 0, sizeof(midi_map_t));
+    midiMaps[gpiB].partner = gpiA;
+    __atomic_store_n(&midiMaps[gpiB].type, MIDI_MAP_ENCODER_B, __ATOMIC_RELAXED);
+    __atomic_store_n(&encoder->type, relative ? MIDI_MAP_ENCODER_REL : MIDI_MAP_ENCODER, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&midiMutex);
+    return 0;
+}
+
+void removeMidiMap(uint32_t gpi) {
+    if(gpi >= MAX_GPI)
+        return;
+    pthread_mutex_lock(&midiMutex);
+    midiUnmap(gpi);
+    pthread_mutex_unlock(&midiMutex);
+}
+
+void clearMidiMaps() {
+    pthread_mutex_lock(&midiMutex);
+    memset(midiMaps, 0, sizeof(midiMaps));
+    pthread_mutex_unlock(&midiMutex);
+}
+
+int getMidiEncoderValue(uint32_t gpi) {
+    if(gpi >= MAX_GPI)
+        return -1;
+    pthread_mutex_lock(&midiMutex);
+    int value = midiMaps[gpi].type == MIDI_MAP_ENCODER ? midiMaps[gpi].value : -1;
+    pthread_mutex_unlock(&midiMutex);
+    return value;
+}
+
+void midiGpiChange(uint32_t gpi, uint8_t value) {
+    // Avoid taking lock for unmapped GPI
+    if(gpi >= MAX_GPI || __atomic_load_n(&midiMaps[gpi].type, __ATOMIC_RELAXED) == MIDI_MAP_NONE)
+        return;
+    pthread_mutex_lock(&midiMutex);
+    midi_map_t* map = &midiMaps[gpi];
+    value = value ? 1 : 0;
+    switch(map->type) {
+        case MIDI_MAP_NOTE:
+        case MIDI_MAP_CC:
+            // Note off is sent as note on with velocity 0 to preserve running status
+            midiAppend(map->status, map->number, (value ^ map->activeLow) ? map->value : 0);
+            break;
+        case MIDI_MAP_ENCODER:
+        case MIDI_MAP_ENCODER_REL:
+            midiEncoderChange(map, (map->quad & 0x01) | value << 1);
+            break;
+        case MIDI_MAP_ENCODER_B: {
+            midi_map_t* encoder = &midiMaps[map->partner];
+            midiEncoderChange(encoder, (encoder->quad & 0x02) | value);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&midiMutex);
+}
+
+void flushMidi() {
+    if(!__atomic_load_n(&midiLength, __ATOMIC_RELAXED))
+        return; // Nothing batched this cycle
+    pthread_mutex_lock(&midiMutex);
+    midiWrite();
+    pthread_mutex_unlock(&midiMutex);
+}
@@ -0,0 +1,115 @@
+/*
+ * ******************************************************************
+ * ZYNTHIAN PROJECT: GPI Library
+ *
+ * Bridge from GPI to MIDI output for Zynthian
+ *
+ * Copyright (C) 2021 Brian Walton <riban@zynthian.org>
+ *
+ * ******************************************************************
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * For a full copy of the GNU General Public License see the LICENSE.txt file.
+ *
+ * ******************************************************************
+ */
+
+/*  MIDI bridge converts GPI changes to MIDI messages within the poll thread, avoiding a round trip through the application.
+    Each GPI may be mapped to a note, a controller or, with a second GPI, a quadrature encoder driving a controller.
+    Messages generated during a poll cycle are batched with running status and written to the output with a single write()
+    at the end of the cycle, so controller to synth latency is one poll period.
+    The output may be any file descriptor, e.g. raw MIDI device (/dev/snd/midiC1D0), pipe or FIFO. Use a non-blocking
+    descriptor to avoid stalling the poll thread if the consumer stops reading - bytes that cannot be written are dropped
+    and counted in stats midiDropped.
+*/
+
+#ifndef ZYNGPIMIDI_H_INCLUDED
+#define ZYNGPIMIDI_H_INCLUDED
+
+#include "gpi.h"
+
+#define MIDI_BUFFER_SIZE        256 // Size of per-cycle output batch, flushed early if full
+#define MIDI_ENCODER_STEPS      4 // Quadrature transitions per encoder detent
+
+/*  Mapping types */
+#define MIDI_MAP_NONE           0 // GPI not mapped
+#define MIDI_MAP_NOTE           1 // Note on with velocity when active, note off (velocity 0) when inactive
+#define MIDI_MAP_CC             2 // Control change with value when active, 0 when inactive
+#define MIDI_MAP_ENCODER        3 // Absolute control change [0..127] adjusted by encoder
+#define MIDI_MAP_ENCODER_REL    4 // Relative control change, binary offset: 65 = +1, 63 = -1
+#define MIDI_MAP_ENCODER_B      5 // Second (B) input of an encoder - mapped with addMidiEncoderMap
+
+/** @brief  Set MIDI output
+*   @param  fd File descriptor to write MIDI to or -1 to disable bridge
+*   @note   Descriptor is not closed by the library. Running status restarts with each batch.
+*/
+void setMidiOutput(int fd);
+
+/** @brief  Get MIDI output
+*   @retval int File descriptor of MIDI output or -1 if disabled
+*/
+int getMidiOutput();
+
+/** @brief  Map a GPI to a note or controller
+*   @param  gpi Index of GPI within global gpimap
+*   @param  type Mapping type [MIDI_MAP_NOTE|MIDI_MAP_CC]
+*   @param  channel MIDI channel [0..15]
+*   @param  number Note or controller number [0..127]
+*   @param  value Note velocity or controller value sent when GPI is active [1..127]
+*   @param  activeLow 1 if GPI is active when low, e.g. button to ground with pull-up
+*   @retval int 0 on success or -1 on invalid parameter
+*   @note   Replaces any existing mapping of the GPI
+*/
+int addMidiMap(uint32_t gpi, uint8_t type, uint8_t channel, uint8_t number, uint8_t value, uint8_t activeLow);
+
+/** @brief  Map a pair of GPI acting as a quadrature encoder to a controller
+*   @param  gpiA Index of encoder A input
+*   @param  gpiB Index of encoder B input
+*   @param  relative 1 for relative control change (MIDI_MAP_ENCODER_REL), 0 for absolute (MIDI_MAP_ENCODER)
+*   @param  channel MIDI channel [0..15]
+*   @param  cc Controller number [0..127]
+*   @param  value Initial value of absolute controller [0..127]
+*   @retval int 0 on success or -1 on invalid parameter
+*   @note   Clockwise (A leads B) increments. GPI must be enabled so that changes are detected.
+*/
+int addMidiEncoderMap(uint32_t gpiA, uint32_t gpiB, uint8_t relative, uint8_t channel, uint8_t cc, uint8_t value);
+
+/** @brief  Remove mapping of a GPI
+*   @param  gpi Index of GPI within global gpimap
+*   @note   Removing either input of an encoder removes the encoder
+*/
+void removeMidiMap(uint32_t gpi);
+
+/** @brief  Remove all mappings
+*/
+void clearMidiMaps();
+
+/** @brief  Get current value of an absolute encoder controller
+*   @param  gpi Index of encoder A input
+*   @retval int Controller value [0..127] or -1 if GPI not mapped to absolute encoder
+*/
+int getMidiEncoderValue(uint32_t gpi);
+
+/** @brief  Convert a change of GPI value to MIDI and add to current batch
+*   @param  gpi Index of GPI within global gpimap
+*   @param  value New GPI value
+*   @note   Called by notifyGpiChange
+*/
+void midiGpiChange(uint32_t gpi, uint8_t value);
+
+/** @brief  Write batched MIDI messages to output
+*   @note   Called by poll thread at end of each cycle
+*/
+void flushMidi();
+
+//-----------------------------------------------------------------------------
+#endif // ZYNGPIMIDI_H_INCLUDED
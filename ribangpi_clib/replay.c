@@ -0,0 +1,330 @@
+/*
+ * ******************************************************************
+ * ZYNTHIAN PROJECT: GPI Library
+ *
+ * Trace driven replay load generator
+ *
+ * Copyright (C) 2021 Brian Walton <riban@zynthian.org>
+ *
+ * ******************************************************************
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * For a full copy of the GNU General Public License see the LICENSE.txt file.
+ *
+ * ******************************************************************
+ */
+
+/*  Replays a recorded or scripted transition trace into fake native GPI registers and simulated I2C expanders whilst the
+    full GPI pipeline (poll thread, drivers, event queue) runs, then reports dropped events, queue high water and CPU time.
+    A consumer thread retrieves events in batches, optionally pausing between batches to emulate a UI frame.
+
+    Trace formats:
+        Binary capture file written by startCapture (capture.h) - replays changes of the captured GPLEV0 mask
+        Text, one transition per line, blank lines and lines starting # ignored:
+            <time_us> rpi <pin> <0|1>               Native GPI level
+            <time_us> mcp <address> <pin> <0|1>     Simulated MCP23017 input [pin 0..15]
+            <time_us> riban <address> <pin> <0|1>   Simulated riban I2C GPI input [pin 0..49]
+        Times are relative to start of replay and must not decrease. Addresses may be decimal or 0x prefixed hexadecimal.
+
+    Usage: ribangpireplay [-p poll_us] [-s speed] [-n loops] [-c consume_ms] [-b] trace
+        -s  Replay speed multiplier, 0 to replay as fast as possible (default 1)
+        -n  Quantity of times to replay trace (default 1)
+        -c  Time consumer sleeps between event batches in milliseconds (default 0)
+        -b  Spend simulated I2C bus time so that expander polling costs real time
+*/
+
+#include "fakegpimem.h" // Provides memory backed /dev/gpiomem
+#include "gpi.h"
+#include "rpigpi.h"
+#include "expandergpi.h"
+#include "ribani2cgpi.h"
+#include "capture.h" // Provides capture file format
+#include "events.h" // Provides event queue
+#include "i2csim.h" // Provides simulated I2C devices
+#include "stats.h" // Provides instrumentation
+#include "timing.h" // Provides timestamps
+#include <pthread.h> // Provides threads
+#include <stdlib.h> // Provides strtoul, realloc
+#include <string.h> // Provides strcmp, memcmp
+#include <time.h> // Provides clock_nanosleep, clock_gettime
+#include <sys/resource.h> // Provides getrusage
+
+#define SOURCE_RPI          0 // Transition of native GPI
+#define SOURCE_MCP23017     1 // Transition of simulated MCP23017 input
+#define SOURCE_RIBAN        2 // Transition of simulated riban I2C GPI input
+#define MAX_SIM_ADDRESS     128 // Quantity of 7-bit I2C addresses
+#define EVENT_BATCH         256 // Maximum quantity of events retrieved by consumer per call
+#define STATS_BUFFER_SIZE   16384
+
+//  Structure describing a change of input levels
+typedef struct transition_t {
+    uint64_t timeNs;        // Time of transition relative to start of trace
+    uint8_t source;         // Input source [SOURCE_RPI|SOURCE_MCP23017|SOURCE_RIBAN]
+    uint8_t address;        // I2C address of simulated device
+    uint64_t mask;          // Bitmask of inputs affected
+    uint64_t levels;        // New levels of inputs in mask
+} transition_t;
+
+static transition_t* trace = NULL; // Transitions in order of time
+static uint32_t traceLength = 0; // Quantity of transitions in trace
+static uint8_t simDevices[MAX_SIM_ADDRESS]; // Source of simulated device at each address, 0xFF if unused
+static uint64_t simLevels[MAX_SIM_ADDRESS]; // Current levels of simulated device inputs
+static volatile uint32_t* regs; // Fake GPI registers
+static uint32_t consumeMs = 0; // Time consumer sleeps between batches
+static volatile uint8_t consuming = 1; // Cleared to stop consumer thread
+static uint32_t received = 0; // Quantity of change events retrieved by consumer
+static uint32_t batches = 0; // Quantity of non-empty batches retrieved by consumer
+static uint32_t largestBatch = 0; // Largest quantity of events retrieved in one batch
+
+// Append transition to trace, returning 0 on success
+int addTransition(uint64_t timeNs, uint8_t source, uint8_t address, uint64_t mask, uint64_t levels) {
+    if(traceLength && timeNs < trace[traceLength - 1].timeNs)
+        return -1;
+    if(!(traceLength & (traceLength - 1))) {
+        // Grow to next power of 2
+        transition_t* grown = realloc(trace, (traceLength ? traceLength * 2 : 64) * sizeof(transition_t));
+        if(!grown)
+            return -1;
+        trace = grown;
+    }
+    trace[traceLength++] = (transition_t){timeNs, source, address, mask, levels};
+    return 0;
+}
+
+// Load transitions from capture file, returning 0 on success or -1 if not a capture file
+int loadCapture(FILE* file) {
+    capture_header_t header;
+    if(fread(&header, sizeof(header), 1, file) != 1 || header.magic != CAPTURE_MAGIC || header.version != CAPTURE_VERSION || !header.capacity)
+        return -1;
+    uint64_t count = header.head < header.capacity ? header.head : header.capacity;
+    capture_record_t* records = malloc(header.capacity * sizeof(capture_record_t));
+    if(!records || fread(records, sizeof(capture_record_t), header.capacity, file) != header.capacity) {
+        free(records);
+        return -1;
+    }
+    // Oldest retained record is first in time
+    for(uint64_t i = header.head - count; i < header.head; ++i) {
+        capture_record_t* record = &records[i % header.capacity];
+        addTransition(record->timestamp, SOURCE_RPI, 0, header.mask, record->level);
+    }
+    free(records);
+    return 0;
+}
+
+// Load transitions from text file, returning 0 on success
+int loadText(FILE* file) {
+    char line[256], source[16];
+    uint32_t lineNumber = 0;
+    while(fgets(line, sizeof(line), file)) {
+        ++lineNumber;
+        char* start = line + strspn(line, " \t");
+        if(*start == '#' || *start == '\n' || *start == '\0')
+            continue;
+        unsigned long long timeUs;
+        unsigned int address = 0, pin, level;
+        int fields = sscanf(start, "%llu %15s %i %i %i", &timeUs, source, &address, &pin, &level);
+        uint8_t type;
+        if(fields == 4 && strcmp(source, "rpi") == 0) {
+            level = pin;
+            pin = address;
+            address = 0;
+            type = SOURCE_RPI;
+        } else if(fields == 5 && strcmp(source, "mcp") == 0) {
+            type = SOURCE_MCP23017;
+        } else if(fields == 5 && strcmp(source, "riban") == 0) {
+            type = SOURCE_RIBAN;
+        } else {
+            fprintf(stderr, "Line %u: invalid transition\n", lineNumber);
+            return -1;
+        }
+        uint32_t pins = type == SOURCE_RPI ? 32 : type == SOURCE_MCP23017 ? 16 : RIBAN_I2C_GPI_COUNT;
+        if(pin >= pins || address >= MAX_SIM_ADDRESS || (type != SOURCE_RPI && simDevices[address] != 0xFF && simDevices[address] != type)) {
+            fprintf(stderr, "Line %u: invalid pin or address\n", lineNumber);
+            return -1;
+        }
+        if(type != SOURCE_RPI)
+            simDevices[address] = type;
+        if(addTransition(timeUs * 1000, type, address, 1ULL << pin, level ? 1ULL << pin : 0) < 0) {
+            fprintf(stderr, "Line %u: time must not decrease\n", lineNumber);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Thread retrieving events as an application would
+void* consume(void* arg) {
+    gpi_event_t events[EVENT_BATCH];
+    while(consuming) {
+        uint32_t count = waitGpiEvents(NULL, events, EVENT_BATCH, 10);
+        if(!count)
+            continue;
+        uint32_t changes = 0;
+        for(uint32_t i = 0; i < count; ++i)
+            if(events[i].type == GPI_EVENT_CHANGE)
+                ++changes;
+        __atomic_fetch_add(&received, changes, __ATOMIC_RELAXED);
+        ++batches;
+        if(count > largestBatch)
+            largestBatch = count;
+        if(consumeMs)
+            usleep(consumeMs * 1000);
+    }
+    return NULL;
+}
+
+// Apply transition, returning quantity of inputs that changed level
+uint32_t applyTransition(transition_t* transition) {
+    uint64_t previous, levels;
+    if(transition->source == SOURCE_RPI) {
+        previous = regs[BCM2835_GPLEV0];
+        levels = (previous & ~transition->mask) | (transition->levels & transition->mask);
+        regs[BCM2835_GPLEV0] = levels;
+    } else {
+        previous = simLevels[transition->address];
+        levels = (previous & ~transition->mask) | (transition->levels & transition->mask);
+        simLevels[transition->address] = levels;
+        i2cSimSetInputs(transition->address, levels);
+    }
+    return __builtin_popcountll(previous ^ levels);
+}
+
+double getCpuMs(struct timeval* time) {
+    return time->tv_sec * 1000.0 + time->tv_usec / 1000.0;
+}
+
+int main(int argc, char* argv[]) {
+    uint32_t period = POLL_SLEEP_US, loops = 1;
+    double speed = 1;
+    uint8_t busTime = 0;
+    int opt;
+    while((opt = getopt(argc, argv, "p:s:n:c:bh")) != -1) {
+        switch(opt) {
+            case 'p': period = atoi(optarg); break;
+            case 's': speed = atof(optarg); break;
+            case 'n': loops = atoi(optarg); break;
+            case 'c': consumeMs = atoi(optarg); break;
+            case 'b': busTime = 1; break;
+            default:
+                printf("Usage: %s [-p poll_us] [-s speed] [-n loops] [-c consume_ms] [-b] trace\n", argv[0]);
+                return opt == 'h' ? 0 : -1;
+        }
+    }
+    if(optind >= argc || !period || !loops || speed < 0) {
+        fprintf(stderr, "Invalid parameters\n");
+        return -1;
+    }
+
+    FILE* file = fopen(argv[optind], "rb");
+    if(!file) {
+        fprintf(stderr, "Failed to open %s\n", argv[optind]);
+        return -1;
+    }
+    memset(simDevices, 0xFF, sizeof(simDevices));
+    if(loadCapture(file) < 0) {
+        rewind(file);
+        if(loadText(file) < 0) {
+            fclose(file);
+            return -1;
+        }
+    }
+    fclose(file);
+    if(!traceLength) {
+        fprintf(stderr, "Trace is empty\n");
+        return -1;
+    }
+
+    // Instantiate native driver first so that GPI index equals BCM pin then simulated devices referenced by trace
+    char path[FAKE_GPIMEM_PATH_LEN];
+    if(createFakeGpiMem(path, &regs) < 0) {
+        fprintf(stderr, "Failed to create fake GPI register file\n");
+        return -1;
+    }
+    setPollPeriod(period);
+    setRpiGpiMemDevice(path);
+    int driver = addRpiGpiDevice();
+    if(driver < 0) {
+        fprintf(stderr, "Failed to add RPi GPI driver\n");
+        return -1;
+    }
+    i2cSetTransport(&i2cSimTransport);
+    i2cSimSetByteTime(I2CSIM_DEFAULT_BYTE_NS, busTime);
+    uint32_t devices = 0;
+    for(uint32_t address = 0; address < MAX_SIM_ADDRESS; ++address) {
+        if(simDevices[address] == SOURCE_MCP23017 && i2cSimAddMcp23017(address) == 0)
+            driver = addMcp23017GpiDevice(address, 0);
+        else if(simDevices[address] == SOURCE_RIBAN && i2cSimAddRiban(address) == 0)
+            driver = addRibanGpiDevice(address);
+        else
+            continue;
+        if(driver < 0) {
+            fprintf(stderr, "Failed to add simulated device at 0x%02x\n", address);
+            return -1;
+        }
+        ++devices;
+    }
+    for(uint32_t gpi = 0; gpi < getCount(); ++gpi)
+        enableGpi(gpi, 1);
+    enableGpiEvents(1);
+
+    uint64_t duration = trace[traceLength - 1].timeNs;
+    printf("Replay: %u transitions over %.3fms x %u loops, speed %g, poll period %uus, %u simulated devices\n",
+        traceLength, duration / 1e6, loops, speed, getPollPeriod(), devices);
+    fflush(stdout);
+    pthread_t consumer;
+    pthread_create(&consumer, NULL, consume, NULL);
+    usleep(2 * period); // Allow initial levels to be read
+    resetStats();
+    struct rusage usageStart, usageEnd;
+    getrusage(RUSAGE_SELF, &usageStart);
+
+    uint64_t edges = 0;
+    uint64_t start = getTimeNs(); // Same timebase as clock_nanosleep
+    for(uint32_t loop = 0; loop < loops; ++loop) {
+        uint64_t loopStart = getTimeNs();
+        for(uint32_t i = 0; i < traceLength; ++i) {
+            if(speed > 0) {
+                uint64_t due = loopStart + trace[i].timeNs / speed;
+                struct timespec ts = {due / 1000000000, due % 1000000000};
+                clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+            }
+            edges += applyTransition(&trace[i]);
+        }
+    }
+    uint64_t elapsed = getTimeNs() - start;
+    // Allow pipeline to drain: two poll cycles plus consumer pause
+    usleep(2 * period + 2 * consumeMs * 1000 + 10000);
+    uint64_t wall = getTimeNs() - start;
+    consuming = 0;
+    pthread_join(consumer, NULL);
+    getrusage(RUSAGE_SELF, &usageEnd);
+    shutdownGpi();
+
+    gpi_stats_t stats;
+    getStats(&stats);
+    uint64_t observed = (uint64_t)received + stats.eventOverflow;
+    double userMs = getCpuMs(&usageEnd.ru_utime) - getCpuMs(&usageStart.ru_utime);
+    double systemMs = getCpuMs(&usageEnd.ru_stime) - getCpuMs(&usageStart.ru_stime);
+    printf("Replayed %llu edges in %.3fms\n", (unsigned long long)edges, elapsed / 1e6);
+    printf("Events: received=%u dropped=%u (queue overflow) coalesced=%llu (reversed between polls)\n", received,
+        stats.eventOverflow, (unsigned long long)(edges > observed ? edges - observed : 0));
+    printf("Event queue: high water=%u of %u, consumer batches=%u largest=%u\n", stats.eventHighWater, GPI_EVENT_QUEUE_SIZE,
+        batches, largestBatch);
+    printf("CPU: user=%.1fms system=%.1fms (%.1f%% of one core), poll cycles=%u\n", userMs, systemMs,
+        100.0 * (userMs + systemMs) * 1e6 / wall, stats.pollCycles);
+
+    char buffer[STATS_BUFFER_SIZE];
+    dumpStats(buffer, sizeof(buffer));
+    printf("\n%s", buffer);
+    free(trace);
+    return 0;
+}
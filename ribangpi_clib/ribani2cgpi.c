@@ -0,0 +1,248 @@
+/*
+ * ******************************************************************
+ * ZYNTHIAN PROJECT: GPI Library
+ *
+ * Library for interfacing riban I2C GPI devices with Zynthian
+ *
+ * Copyright (C) 2021 Brian Walton <riban@zynthian.org>
+ *
+ * ******************************************************************
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * For a full copy of the GNU General Public License see the LICENSE.txt file.
+ *
+ * ******************************************************************
+ */
+
+#include "ribani2cgpi.h"
+#include "i2c.h" // Provides I2C interface
+
+#define RIBAN_I2C_RESPONSE_BYTES (1 + RIBAN_I2C_BITMAP_BYTES) // Sequence and levels
+#define RIBAN_I2C_MASKED_BYTES (1 + 2 * RIBAN_I2C_BITMAP_BYTES) // Command, mask and values
+
+//  Structure describing riban I2C GPI driver config
+typedef struct ribani2cgpidata_t {
+    uint8_t address;    // I2C address
+    i2c_health_t health; // Health of device
+    uint8_t sequence;   // Sequence number of last levels read from device
+    uint8_t active;     // 1 to read levels on next poll without first checking sequence
+    uint64_t dir;       // Shadow of direction (bit set: output) used to restore device after failure
+    uint64_t pull;      // Shadow of pull-ups
+    uint64_t olat;      // Shadow of output latch
+    uint64_t dirty;     // Bitmap of outputs with changes pending write-behind
+} ribani2cgpidata_t;
+
+/*  Private helper functions */
+ribani2cgpidata_t* getRibanConfig(uint32_t driver); // Get a pointer to the driver's config data or NULL for invalid driver
+void initRibanDevice(ribani2cgpidata_t* config); // Restore device configuration from shadow
+
+void packRibanBitmap(uint64_t bitmap, uint8_t* buffer) {
+    for(uint8_t i = 0; i < RIBAN_I2C_BITMAP_BYTES; ++i)
+        buffer[i] = bitmap >> (i * 8);
+}
+
+uint64_t unpackRibanBitmap(const uint8_t* buffer) {
+    uint64_t bitmap = 0;
+    for(uint8_t i = 0; i < RIBAN_I2C_BITMAP_BYTES; ++i)
+        bitmap |= (uint64_t)buffer[i] << (i * 8);
+    return bitmap & RIBAN_I2C_BITMAP_MASK;
+}
+
+// Send command and optionally read response, returning 0 on success or -1 on failure or if device access is suspended
+int ribanTransfer(ribani2cgpidata_t* config, const uint8_t* command, uint8_t commandLen, uint8_t* response, uint8_t len) {
+    if(!i2cHealthReady(&config->health))
+        return -1;
+    int result;
+    if(len)
+        result = i2cWriteRead(config->address, command, commandLen, response, len);
+    else
+        result = i2cWrite(config->address, command, commandLen);
+    if(i2cHealthUpdate(&config->health, result))
+        initRibanDevice(config);
+    return result < 0 ? -1 : 0;
+}
+
+// Write masked subset of a bitmap in a single transaction
+int writeRibanMasked(ribani2cgpidata_t* config, uint8_t command, uint64_t mask, uint64_t values) {
+    uint8_t data[RIBAN_I2C_MASKED_BYTES];
+    data[0] = command;
+    packRibanBitmap(mask, data + 1);
+    packRibanBitmap(values, data + 1 + RIBAN_I2C_BITMAP_BYTES);
+    return ribanTransfer(config, data, RIBAN_I2C_MASKED_BYTES, NULL, 0);
+}
+
+void initRibanDevice(ribani2cgpidata_t* config) {
+    // Output latch before direction to avoid glitches
+    writeRibanMasked(config, RIBAN_I2C_CMD_OUTPUT, RIBAN_I2C_BITMAP_MASK, config->olat);
+    writeRibanMasked(config, RIBAN_I2C_CMD_PULLUP, RIBAN_I2C_BITMAP_MASK, config->pull);
+    writeRibanMasked(config, RIBAN_I2C_CMD_DIRECTION, RIBAN_I2C_BITMAP_MASK, config->dir);
+    config->active = 1; // Levels may have changed whilst device was unavailable
+}
+
+int addRibanGpiDevice(uint8_t address) {
+    if(address < 0x08 || address > 0x77)
+        return -1;
+    lockGpiDrivers();
+    uint8_t driverCount;
+    for(driverCount = 0; driverCount < MAX_GPI_DRIVERS; ++driverCount) {
+        if(gpiDrivers[driverCount].type == GPI_DRIVER_NONE)
+            break;
+        if(gpiDrivers[driverCount].type == GPI_DRIVER_RIBAN_I2C && ((ribani2cgpidata_t*)gpiDrivers[driverCount].config)->address == address) {
+            unlockGpiDrivers();
+            return driverCount;
+        }
+    }
+    if(driverCount >= MAX_GPI_DRIVERS || zynGpiCount + RIBAN_I2C_GPI_COUNT > MAX_GPI || i2cOpen() < 0) {
+        unlockGpiDrivers();
+        return -1;
+    }
+
+    gpi_driver_t* driver = &gpiDrivers[driverCount];
+    driver->type = GPI_DRIVER_RIBAN_I2C;
+    driver->size = RIBAN_I2C_GPI_COUNT;
+    driver->offset = zynGpiCount;
+    driver->config = (uint8_t*)malloc(sizeof(ribani2cgpidata_t));
+    ribani2cgpidata_t* config = (ribani2cgpidata_t*)driver->config;
+    config->address = address;
+    i2cHealthReset(&config->health);
+    config->sequence = 0;
+    config->dir = 0; // Power on default: all inputs
+    config->pull = 0;
+    config->olat = 0;
+    config->dirty = 0;
+    // Configure device - if device does not respond it will be re-probed and configured by poll
+    initRibanDevice(config);
+    driver->setState = setRibanGpiState;
+    driver->setDirection = setRibanGpiDirection;
+    driver->setPull = setRibanGpiPull;
+    driver->getStatus = getRibanGpiStatus;
+    driver->flush = flushRibanGpi;
+    driver->gpis = (gpi_t*) malloc (driver->size * sizeof(gpi_t));
+    for(int i  = 0; i < driver->size; ++i) {
+        (driver->gpis[i]).value = 0;
+        (driver->gpis[i]).enabled = 0;
+        (driver->gpis[i]).dir = INPUT;
+        (driver->gpis[i]).rateClass = GPI_RATE_DEFAULT;
+        gpimap[zynGpiCount].driver = driverCount;
+        gpimap[zynGpiCount++].offset = i;
+    }
+    driver->poll = pollRibanGpi; // Assign last so that poll thread does not see partially populated driver
+    unlockGpiDrivers();
+    updatePolling();
+    return driverCount;
+}
+
+ribani2cgpidata_t* getRibanConfig(uint32_t driver) {
+    if(driver >= MAX_GPI_DRIVERS || gpiDrivers[driver].type != GPI_DRIVER_RIBAN_I2C)
+        return NULL;
+    return (ribani2cgpidata_t*)gpiDrivers[driver].config;
+}
+
+int setRibanGpiOutputs(uint32_t driver, uint64_t mask, uint64_t values) {
+    lockGpiDrivers(); // Serialise with poll thread flush, poll and recovery
+    ribani2cgpidata_t* config = getRibanConfig(driver);
+    if(!config) {
+        unlockGpiDrivers();
+        return -1;
+    }
+    mask &= RIBAN_I2C_BITMAP_MASK;
+    config->olat = (config->olat & ~mask) | (values & mask);
+    gpi_driver_t* pDriver = &gpiDrivers[driver];
+    for(uint32_t offset = 0; offset < pDriver->size; ++offset)
+        if(bitRead(mask, offset))
+            pDriver->gpis[offset].value = bitRead(values, offset);
+    int result = 0;
+    if(getGpiWriteBehind())
+        config->dirty |= mask;
+    else
+        result = writeRibanMasked(config, RIBAN_I2C_CMD_OUTPUT, mask, values);
+    unlockGpiDrivers();
+    return result;
+}
+
+void flushRibanGpi(uint32_t driver) {
+    ribani2cgpidata_t* config = getRibanConfig(driver);
+    if(!config)
+        return;
+    uint64_t dirty = config->dirty;
+    config->dirty = 0;
+    if(dirty)
+        writeRibanMasked(config, RIBAN_I2C_CMD_OUTPUT, dirty, config->olat);
+}
+
+void setRibanGpiState(uint32_t gpi, uint8_t state) {
+    //!@todo Validate GPI enabled and direction=output
+    uint32_t offset = gpimap[gpi].offset;
+    setRibanGpiOutputs(gpimap[gpi].driver, 1ULL << offset, state ? 1ULL << offset : 0);
+}
+
+void setRibanGpiDirection(uint32_t gpi, uint8_t dir) {
+    // Range check already performed by GPI library function
+    uint32_t offset = gpimap[gpi].offset;
+    ribani2cgpidata_t* config = getRibanConfig(gpimap[gpi].driver);
+    if(!config)
+        return;
+    config->dir = (config->dir & ~(1ULL << offset)) | ((uint64_t)(dir ? 1 : 0) << offset); // bitWrite is limited to unsigned long
+    writeRibanMasked(config, RIBAN_I2C_CMD_DIRECTION, 1ULL << offset, config->dir);
+    getGpi(gpi).dir = dir?1:0;
+}
+
+void setRibanGpiPull(uint32_t gpi, uint8_t mode) {
+    // Range check already performed by GPI library function
+    uint32_t offset = gpimap[gpi].offset;
+    ribani2cgpidata_t* config = getRibanConfig(gpimap[gpi].driver);
+    if(!config || mode == PUD_DOWN)
+        return;
+    config->pull = (config->pull & ~(1ULL << offset)) | ((uint64_t)(mode == PUD_UP) << offset);
+    writeRibanMasked(config, RIBAN_I2C_CMD_PULLUP, 1ULL << offset, config->pull);
+}
+
+uint8_t pollRibanGpi(uint32_t driver) {
+    ribani2cgpidata_t* config = getRibanConfig(driver);
+    if(!config)
+        return 0;
+    uint8_t command[2] = {RIBAN_I2C_CMD_SINCE, config->sequence};
+    uint8_t response[RIBAN_I2C_RESPONSE_BYTES];
+    if(!config->active) {
+        // Idle: single byte response unless sequence has changed
+        if(ribanTransfer(config, command, 2, response, 1) < 0 || (response[0] == config->sequence && !config->active))
+            return 0; // Failed, unchanged or recovered (active set by re-initialisation)
+    }
+    if(ribanTransfer(config, command, 2, response, RIBAN_I2C_RESPONSE_BYTES) < 0)
+        return 0;
+    // Keep reading full response each scan whilst GPI are changing
+    config->active = response[0] != config->sequence;
+    config->sequence = response[0];
+    uint64_t levels = unpackRibanBitmap(response + 1);
+    // Update every enabled GPI, including those not due, because the change sequence now covers all of them
+    uint8_t value, changed = 0;
+    gpi_driver_t* pDriver = &gpiDrivers[driver];
+    for(uint32_t offset = 0; offset < pDriver->size; ++offset) {
+        gpi_t* gpi = &(pDriver->gpis[offset]);
+        if(gpi->enabled) {
+            value = bitRead(levels, offset);
+            if(gpi->value == value)
+                continue;
+            changed = 1;
+            gpi->value = value;
+            notifyGpiChange(pDriver->offset + offset, value);
+        }
+    }
+    return changed;
+}
+
+uint8_t getRibanGpiStatus(uint32_t driver) {
+    ribani2cgpidata_t* config = getRibanConfig(driver);
+    if(!config)
+        return GPI_STATUS_INVALID;
+    return config->health.status;
+}
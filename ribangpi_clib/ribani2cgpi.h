@@ -0,0 +1,117 @@
+/*
+ * ******************************************************************
+ * ZYNTHIAN PROJECT: GPI Library
+ *
+ * Library for interfacing riban I2C GPI devices with Zynthian
+ *
+ * Copyright (C) 2021 Brian Walton <riban@zynthian.org>
+ *
+ * ******************************************************************
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * For a full copy of the GNU General Public License see the LICENSE.txt file.
+ *
+ * ******************************************************************
+ */
+
+/*  riban I2C GPI device provides 50 GPI accessed with a bulk protocol so that a whole control surface costs one short
+    transaction per scan.
+
+    Bitmaps are packed, 7 bytes (56 bits) little endian: GPI 0 is bit 0 of the first byte, GPI 49 is bit 1 of the 7th byte.
+    The device increments an 8-bit sequence number each time any reported GPI level changes.
+
+    Command     Access  Bytes                       Description
+      00h        R      sequence, levels[7]         Sequence and levels of all GPI (outputs report their latch)
+      08h        W,R    W: N  R: sequence, levels[7] Changes since sequence N - device releases its interrupt line if N is current
+      10h        W      mask[7], values[7]          Set output latch of GPI with mask bit set
+      18h        W      mask[7], values[7]          Set direction of GPI with mask bit set (bit set: output)
+      20h        W      mask[7], values[7]          Set pull-up of GPI with mask bit set (bit set: enabled)
+
+    Reads are combined write-command/read transactions and the host chooses how many bytes to read. The driver reads only
+    the sequence byte from command 08h whilst the device is idle and reads the full response once the sequence changes.
+    Whilst GPI continue to change each scan reads the full response so there is still only one transaction per scan.
+
+    I2C address range 0x08..0x77
+    Power on:
+        All GPI are inputs without pull-up, output latch 0
+*/
+
+#ifndef ZYNRIBANI2CGPI_H_INCLUDED
+#define ZYNRIBANI2CGPI_H_INCLUDED
+
+#include "gpi.h"
+
+#define RIBAN_I2C_GPI_COUNT     50 // Quantity of GPI provided by device
+#define RIBAN_I2C_BITMAP_BYTES  7 // Size of packed GPI bitmap
+#define RIBAN_I2C_BITMAP_MASK   0x0003FFFFFFFFFFFFULL // Valid bits of GPI bitmap
+
+/*  Commands */
+#define RIBAN_I2C_CMD_LEVELS    0x00
+#define RIBAN_I2C_CMD_SINCE     0x08
+#define RIBAN_I2C_CMD_OUTPUT    0x10
+#define RIBAN_I2C_CMD_DIRECTION 0x18
+#define RIBAN_I2C_CMD_PULLUP    0x20
+
+/** @brief  Instantiate an instance of a riban I2C GPI interface driver providing 50 GPI pins
+*   @param  address I2C address [0x08..0x77]
+*   @retval int Index of new GPI driver or -1 on failure
+*   @note   Index of GPI depends on order of instantiation
+*/
+int addRibanGpiDevice(uint8_t address);
+
+/** @brief  Set output latch of several GPI in a single transaction
+*   @param  driver Index of driver
+*   @param  mask Bitmap of GPI to change, bit 0 is first GPI of driver
+*   @param  values Bitmap of new states
+*   @retval int 0 on success or -1 on failure or invalid driver
+*   @note   With write-behind enabled the change is written by the next poll cycle or flushGpi
+*   @note   Takes driver lock so may be called from any thread
+*/
+int setRibanGpiOutputs(uint32_t driver, uint64_t mask, uint64_t values);
+
+/** @brief  Write output changes deferred by write-behind in a single masked write
+*   @param  driver Index of driver
+*/
+void flushRibanGpi(uint32_t driver);
+
+/** @brief  Set GPI state
+*   @param  gpi Index of GPI within global gpimap
+*   @param  state New GPI state
+*/
+void setRibanGpiState(uint32_t gpi, uint8_t state);
+
+/** @brief  Set GPI direction
+*   @param  gpi Index of GPI within global gpimap
+*   @param  dir Direction [0:Input, 1:Output]
+*/
+void setRibanGpiDirection(uint32_t gpi, uint8_t dir);
+
+/** @brief  Set GPI pull up resistors
+*   @param  gpi Index of GPI within global gpimap
+*   @param  mode Pull mode [PUD_OFF|PUD_UP] - pull-down not supported
+*/
+void setRibanGpiPull(uint32_t gpi, uint8_t mode);
+
+/** @brief  Poll for change of state
+*   @param  driver Index of driver
+*   @retval uint8_t 1 if any GPI within driver has changed else 0
+*/
+uint8_t pollRibanGpi(uint32_t driver);
+
+/** @brief  Get device status
+*   @param  driver Index of driver
+*   @retval uint8_t Status [GPI_STATUS_OK|GPI_STATUS_RETRY|GPI_STATUS_QUARANTINED|GPI_STATUS_INVALID]
+*/
+uint8_t getRibanGpiStatus(uint32_t driver);
+
+//-----------------------------------------------------------------------------
+#endif // ZYNRIBANI2CGPI_H_INCLUDED
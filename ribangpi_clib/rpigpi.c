@@ -24,50 +24,67 @@
  */
 
 #include "rpigpi.h"
+#include "board.h" //Provides board capabilities
 #include <sys/mman.h> //Provides mmap
 #include <fcntl.h> //Provides open
 #include <unistd.h> //Provides close
+#include "timing.h" //Provides timestamps
 
 #define MAX_RPI_GPI 32 // Actually 54 but only 2-27 available
 #define BLOCK_SIZE  (4 * 1024)
-
-//  BCM2835 Registers
-#define BCM2835_GPSET0      7
-#define BCM2835_GPCLR0      10
-#define BCM2835_GPLEV0      13
-#define BCM2835_GPEDS0      16
-#define BCM2835_GPREN0      19
-#define BCM2835_GPFEN0      22
-#define BCM2835_GPHEN0      25
-#define BCM2835_GPLEN0      28
-#define BCM2835_GPAREN0     31
-#define BCM2835_GPAFEN0     34
-#define BCM2835_GPPUD       37
-#define BCM2835_GPPUDCLK0   38
+#define PULL_SETUP_US   1 // GPPUD setup and hold time: 150 cycles is 0.6us on the slowest RPi so let's wait 1us
+#define MAX_FSEL_REGS   ((MAX_RPI_GPI + 9) / 10) // Quantity of function select registers covering GPI 0-31
 
 uint32_t* gpiMmap;
-static const uint8_t unavailableGpi[MAX_RPI_GPI] = {1,1,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,1,1,1,1};
+static const char* gpiMemDevice = "/dev/gpiomem"; // Path of GPI register file
+static uint8_t pullCntrl = 0; // 1 if SoC has BCM2711 pull up/down registers
+static uint32_t availableGpi = 0; // Bitmask of GPI available on this board, populated at driver instantiation
+static uint8_t pullReg = 0; // Word offset of first pull register for board's pull scheme, populated at driver instantiation
+static uint8_t fselRegs = 0; // Quantity of function select registers covering available GPI, populated at driver instantiation
+
+void setRpiGpiMemDevice(const char* path) {
+    gpiMemDevice = path ? path : "/dev/gpiomem";
+}
 
 int addRpiGpiDevice() {
     //!@todo Abstract device non-specific code
+    lockGpiDrivers();
     uint8_t driverCount;
     for(driverCount = 0; driverCount < MAX_GPI_DRIVERS; ++driverCount) {
-        if(gpiDrivers[driverCount].type == GPI_DRIVER_RPI)
+        if(gpiDrivers[driverCount].type == GPI_DRIVER_RPI) {
+            unlockGpiDrivers();
             return driverCount;
+        }
         if(gpiDrivers[driverCount].type == GPI_DRIVER_NONE)
             break;
     }
-    if(driverCount >= MAX_GPI_DRIVERS)
+    if(driverCount >= MAX_GPI_DRIVERS || zynGpiCount + MAX_RPI_GPI > MAX_GPI) {
+        unlockGpiDrivers();
         return -1;
+    }
+
+    const board_caps_t* caps = getBoard()->caps;
+    if(!caps->gpiomem) {
+        unlockGpiDrivers();
+        return -1; // SoC GPI registers not accessible via gpiomem
+    }
 
     // Create memory map of GPI
-    int fd = open("/dev/gpiomem", O_RDWR|O_SYNC);
-    if(fd < 0)
+    int fd = open(gpiMemDevice, O_RDWR|O_SYNC);
+    if(fd < 0) {
+        unlockGpiDrivers();
         return -1;
+    }
     gpiMmap = mmap(NULL, BLOCK_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
     close(fd); //Don't need the file open after memory map
-    if(gpiMmap == MAP_FAILED)
+    if(gpiMmap == MAP_FAILED) {
+        unlockGpiDrivers();
         return -1;
+    }
+
+    availableGpi = caps->available;
+    fselRegs = caps->fselRegs < MAX_FSEL_REGS ? caps->fselRegs : MAX_FSEL_REGS;
+    pullCntrl = getBoardPullScheme(gpiMmap, &pullReg) == BOARD_PULL_DIRECT;
 
     gpi_driver_t* driver = &gpiDrivers[driverCount];
     driver->type = GPI_DRIVER_RPI;
@@ -76,29 +93,41 @@ int addRpiGpiDevice() {
     driver->setState = setRpiGpiState;
     driver->setDirection = setRpiGpiDirection;
     driver->setPull= setRpiGpiPull;
-    driver->poll = pollRpiGpi;
     driver->destroy = destroyRpiGpiDevice;
+    driver->configure = configureRpiGpi;
+    // Adopt current pin configuration rather than forcing inputs which would glitch pins configured by another process
+    uint32_t fsel[MAX_FSEL_REGS] = {0};
+    for(uint8_t reg = 0; reg < fselRegs; ++reg)
+        fsel[reg] = *(gpiMmap + reg);
     driver->gpis = (gpi_t*) malloc (driver->size * sizeof(gpi_t));
     for(int i  = 0; i < driver->size; ++i) {
         (driver->gpis[i]).value = 0;
         (driver->gpis[i]).enabled = 0;
-        (driver->gpis[i]).dir = 0;
+        (driver->gpis[i]).dir = ((fsel[i / 10] >> ((i % 10) * 3)) & 7) == OUTPUT;
+        (driver->gpis[i]).rateClass = GPI_RATE_DEFAULT;
         gpimap[zynGpiCount].driver = driverCount;
         gpimap[zynGpiCount++].offset = i;
-        setRpiGpiDirection(i, INPUT);
     }
+    driver->poll = pollRpiGpi; // Assign last so that poll thread does not see partially populated driver
+    unlockGpiDrivers();
+    updatePolling();
 
     return driverCount;
 }
 
 void destroyRpiGpiDevice() {
     munmap(gpiMmap, BLOCK_SIZE);
+    gpiMmap = NULL;
+}
+
+volatile uint32_t* getRpiGpiMap() {
+    return gpiMmap;
 }
 
 void setRpiGpiState(uint32_t gpi, uint8_t state) {
     //!@todo Validate GPI enabled and direction=output
     uint32_t offset = gpimap[gpi].offset;
-    if(offset > 31 | unavailableGpi[offset])
+    if(offset > 31 || !(availableGpi & (1 << offset)))
         return;
     if(state)
         *(gpiMmap + BCM2835_GPSET0) = 1 << offset;
@@ -108,7 +137,7 @@ void setRpiGpiState(uint32_t gpi, uint8_t state) {
 
 uint8_t getRpiGpiState(uint32_t gpi) {
     uint32_t offset = gpimap[gpi].offset;
-    if(offset > 31 | unavailableGpi[offset])
+    if(offset > 31 || !(availableGpi & (1 << offset)))
         return 0;
 //    return(((*(gpiMmap + BCM2835_GPLEV0 + offset / 32)) & (1 << (offset % 32))) != 0); //!@todo Should we optimise this due to fewer than 32 GPI being exposed?
     return(((*(gpiMmap + BCM2835_GPLEV0)) & (1 << offset)) != 0);
@@ -117,27 +146,110 @@ uint8_t getRpiGpiState(uint32_t gpi) {
 void setRpiGpiDirection(uint32_t gpi, uint8_t dir) {
     // Range check already performed by GPI library function
     uint32_t offset = gpimap[gpi].offset;
-    if(offset > 31 | unavailableGpi[offset])
+    if(offset > 31 || !(availableGpi & (1 << offset)))
         return;
-    //Clear configuration bits
-    *(gpiMmap + (offset / 10)) &= ~(7 << ((offset % 10) * 3)); //reset 3 flags for this gpi
-    //Set configuration bits to match requested mode
-    *(gpiMmap + (offset / 10)) |= ((dir & 0x01) << ((offset % 10) * 3)); //Configure for function
+    // Replace 3 function bits in a single write so that pin does not pass through input mode
+    uint32_t current = *(gpiMmap + (offset / 10));
+    uint32_t value = (current & ~(7 << ((offset % 10) * 3))) | ((dir & 0x01) << ((offset % 10) * 3));
+    if(value != current)
+        *(gpiMmap + (offset / 10)) = value;
     getGpi(gpi).dir = dir?1:0; // Update value upon success
 }
 
 void setRpiGpiPull(uint32_t gpi, uint8_t mode) {
     uint32_t offset = gpimap[gpi].offset;
-    if(offset > 31 || unavailableGpi[offset])
+    if(offset > 31 || !(availableGpi & (1 << offset)))
+        return;
+    setRpiGpiPullMask(1 << offset, mode);
+}
+
+void setRpiGpiPullMask(uint32_t mask, uint8_t mode) {
+    if(!gpiMmap)
         return;
-    *(gpiMmap + BCM2835_GPPUD) = (uint32_t)mode & 3;
-    usleep(1); //Need to wait 150 cycles which is 0.6us on the slowest RPi so let's wait 1us
-//    *(gpiMmap + BCM2835_GPPUDCLK0 + (offset / 32)) = 1 << (offset % 32); //!@todo Should we optimise this due to fewer than 32 GPI being exposed?
-    *(gpiMmap + BCM2835_GPPUDCLK0) = (1 << offset);
-    usleep(1); //Need to wait 150 cycles which is 0.6us on the slowest RPi so let's wait 1us
-//    *(gpiMmap + BCM2835_GPPUDCLK0 + (offset / 32)) = 0; //!@todo Should we optimise this due to fewer than 32 GPI being exposed?
-    *(gpiMmap + BCM2835_GPPUD) = 0;
-    *(gpiMmap + BCM2835_GPPUDCLK0) = 0;
+    mask &= availableGpi;
+    if(!mask)
+        return;
+    if(pullCntrl) {
+        // BCM2711 has 2 bits per GPI with up and down swapped compared to GPPUD
+        uint32_t value = mode == PUD_UP ? 1 : mode == PUD_DOWN ? 2 : 0;
+        for(uint32_t reg = 0; reg < 2; ++reg) {
+            uint32_t clear = 0, set = 0;
+            for(uint32_t bit = 0; bit < 16; ++bit) {
+                if(mask & (1 << (reg * 16 + bit))) {
+                    clear |= 3 << (bit * 2);
+                    set |= value << (bit * 2);
+                }
+            }
+            if(!clear)
+                continue;
+            uint32_t current = *(gpiMmap + pullReg + reg);
+            if(((current & ~clear) | set) != current)
+                *(gpiMmap + pullReg + reg) = (current & ~clear) | set;
+        }
+        return;
+    }
+    // GPPUD at pullReg, GPPUDCLK0 follows
+    *(gpiMmap + pullReg) = (uint32_t)mode & 3;
+    spinDelayUs(PULL_SETUP_US);
+    *(gpiMmap + pullReg + 1) = mask;
+    spinDelayUs(PULL_SETUP_US);
+    *(gpiMmap + pullReg) = 0;
+    *(gpiMmap + pullReg + 1) = 0;
+}
+
+int configureRpiGpi(uint32_t driver, const gpi_config_t* config) {
+    if(!gpiMmap)
+        return -1;
+    uint32_t mask = config->mask & availableGpi;
+    int writes = 0;
+    // Function select: read each register once and write only if a GPI function changes
+    for(uint8_t reg = 0; reg < fselRegs; ++reg) {
+        uint32_t clear = 0, set = 0;
+        for(uint8_t offset = reg * 10; offset < reg * 10 + 10 && offset < MAX_RPI_GPI; ++offset) {
+            if(!(mask & (1 << offset)))
+                continue;
+            clear |= 7 << ((offset % 10) * 3);
+            set |= ((config->output >> offset) & 1) << ((offset % 10) * 3);
+            gpiDrivers[driver].gpis[offset].dir = (config->output >> offset) & 1;
+        }
+        uint32_t current = *(gpiMmap + reg);
+        uint32_t value = (current & ~clear) | set;
+        if(value != current) {
+            *(gpiMmap + reg) = value;
+            ++writes;
+        }
+    }
+    uint32_t up = mask & config->pullUp;
+    uint32_t down = mask & config->pullDown & ~config->pullUp;
+    if(pullCntrl) {
+        // BCM2711 pull registers are readable so compare with current
+        for(uint32_t reg = 0; reg < 2; ++reg) {
+            uint32_t clear = 0, set = 0;
+            for(uint32_t bit = 0; bit < 16; ++bit) {
+                uint32_t pin = 1 << (reg * 16 + bit);
+                if(!(mask & pin))
+                    continue;
+                clear |= 3 << (bit * 2);
+                set |= ((up & pin) ? 1 : (down & pin) ? 2 : 0) << (bit * 2);
+            }
+            uint32_t current = *(gpiMmap + pullReg + reg);
+            uint32_t value = (current & ~clear) | set;
+            if(value != current) {
+                *(gpiMmap + pullReg + reg) = value;
+                ++writes;
+            }
+        }
+        return writes;
+    }
+    // BCM2835 pull state is write-only: one GPPUD sequence (4 writes) per requested mode
+    uint32_t modes[3] = {mask & ~up & ~down, down, up}; // Indexed by PUD_OFF, PUD_DOWN, PUD_UP
+    for(uint8_t mode = PUD_OFF; mode <= PUD_UP; ++mode) {
+        if(!modes[mode])
+            continue;
+        setRpiGpiPullMask(modes[mode], mode);
+        writes += 4;
+    }
+    return writes;
 }
 
 uint8_t pollRpiGpi(uint32_t driver) {
@@ -146,12 +258,13 @@ uint8_t pollRpiGpi(uint32_t driver) {
     gpi_driver_t* pDriver = &gpiDrivers[driver];
     for(int offset = 2; offset < 28; ++offset) {
         gpi_t* gpi = &(pDriver->gpis[offset]);
-        if(gpi->enabled) {
-            value = getRpiGpiState(offset);
+        if(isGpiDue(*gpi)) {
+            value = getRpiGpiState(pDriver->offset + offset);
             if(gpi->value == value)
                 continue;
             changed = 1;
             gpi->value = value;
+            notifyGpiChange(pDriver->offset + offset, value);
         }
     }
     return changed;
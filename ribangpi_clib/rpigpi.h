@@ -44,9 +44,37 @@
 /*  Ensure GPI driver type is unique */
 #define GPI_DRIVER_RPI          1
 
+//  BCM2835 Registers (32-bit word offset from start of GPI memory map)
+#define BCM2835_GPSET0      7
+#define BCM2835_GPCLR0      10
+#define BCM2835_GPLEV0      13
+#define BCM2835_GPEDS0      16
+#define BCM2835_GPREN0      19
+#define BCM2835_GPFEN0      22
+#define BCM2835_GPHEN0      25
+#define BCM2835_GPLEN0      28
+#define BCM2835_GPAREN0     31
+#define BCM2835_GPAFEN0     34
+#define BCM2835_GPPUD       37
+#define BCM2835_GPPUDCLK0   38
+
+//  BCM2711 Registers (32-bit word offset from start of GPI memory map)
+#define BCM2711_GPPUPPDN0   57 // Pull up/down for GPI 0-15, 2 bits per GPI [00:None, 01:Up, 10:Down]
+#define BCM2711_GPPUPPDN3   60 // Reads as BCM2835_GPIO_MAGIC on SoC without BCM2711 pull registers
+#define BCM2835_GPIO_MAGIC  0x6770696f // "gpio" - value of unimplemented registers on BCM2835 family
+
+/** @brief  Set path of file to memory map for GPI register access
+*   @param  path Path of file or NULL for default "/dev/gpiomem"
+*   @note   Must be called before addRpiGpiDevice. Allows a memory backed file to stand in for hardware, e.g. for benchmarks.
+*   @note   Path string must remain valid whilst driver is in use
+*/
+void setRpiGpiMemDevice(const char* path);
+
 /** @brief  Instantiate an instance of a naitive Raspberry Pi GPI interface driver providing 16 GPI pins
 *   @retval int Index of new GPI driver or -1 on failure
 *   @note   Index of GPI depends on order of instantiation
+*   @note   Pins are not reconfigured - direction of each GPI is read from function select registers. Use configureGpiDriver
+*           to apply a desired configuration.
 *   @todo   Maybe this is always instantiated
 */
 int addRpiGpiDevice();
@@ -55,6 +83,12 @@ int addRpiGpiDevice();
 */
 void destroyRpiGpiDevice();
 
+/** @brief  Get memory map of GPI registers
+*   @retval uint32_t* Pointer to first GPI register or NULL if driver not instantiated
+*   @note   Allows direct register access, e.g. for high rate sampling
+*/
+volatile uint32_t* getRpiGpiMap();
+
 /** @brief  Set GPI state
 *   @param  gpi Index of GPI within global gpimap
 *   @param  state New GPI state
@@ -79,6 +113,22 @@ void setRpiGpiDirection(uint32_t gpi, uint8_t dir);
 */
 void setRpiGpiPull(uint32_t gpi, uint8_t mode);
 
+/** @brief  Set pull up/down mode of several GPI in one operation
+*   @param  mask Bitmask of Raspberry Pi GPI pin numbers (bit 0 = GPI 0)
+*   @param  mode Pull mode [PUD_OFF|PUD_DOWN|PUD_UP]
+*   @note   Unavailable pins are ignored. BCM2711 pull registers are written directly, other SoC clock all pins in a single GPPUD sequence.
+*/
+void setRpiGpiPullMask(uint32_t mask, uint8_t mode);
+
+/** @brief  Apply desired configuration, writing only function select and pull registers that differ
+*   @param  driver Index of driver
+*   @param  config Pointer to desired configuration
+*   @retval int Quantity of register writes performed or -1 if driver not instantiated
+*   @note   GPI configured as an alternative function are set to the requested input / output function.
+*           BCM2835 family pull state cannot be read so requested pulls are always clocked, one GPPUD sequence per mode.
+*/
+int configureRpiGpi(uint32_t driver, const gpi_config_t* config);
+
 /** @brief  Poll for change of state
 *   @param  gpi Index of GPI within global gpimap
 *   @retval uint8_t 1 if any GPI within driver has changed else 0
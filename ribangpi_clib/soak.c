@@ -0,0 +1,190 @@
+/*
+ * ******************************************************************
+ * ZYNTHIAN PROJECT: GPI Library
+ *
+ * Input latency and jitter soak test harness
+ *
+ * Copyright (C) 2021 Brian Walton <riban@zynthian.org>
+ *
+ * ******************************************************************
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * For a full copy of the GNU General Public License see the LICENSE.txt file.
+ *
+ * ******************************************************************
+ */
+
+/*  Measures time from an edge injected into a fake /dev/gpiomem to notification by the poll thread.
+    An injector thread toggles a GPI level at randomised intervals around the requested rate so that edges are not phase locked to polling.
+    Detection delay is recorded in a 1us resolution histogram. Edges that are reversed before being sampled are counted as missed.
+    Optional load threads spin to apply synthetic CPU load.
+
+    Usage: ribangpisoak [-d seconds] [-p poll_us] [-r edges_per_second] [-l load_threads] [-s other|fifo|rr] [-P priority] [-g gpi] [-i report_seconds]
+*/
+
+#include "fakegpimem.h" // Provides memory backed /dev/gpiomem
+#include "gpi.h"
+#include "rpigpi.h"
+#include "stats.h" // Provides instrumentation
+#include "timing.h" // Provides timestamps
+#include <pthread.h> // Provides threads
+#include <sched.h> // Provides scheduling policies
+#include <stdlib.h> // Provides atoi, rand_r
+#include <string.h> // Provides strcmp, strerror
+#include <time.h> // Provides clock_nanosleep
+
+#define EDGE_RING_SIZE      1024 // Quantity of injection timestamps retained - must be power of 2
+#define LATENCY_BUCKETS     100000 // Latency histogram size in microseconds, longer latencies are counted in last bucket
+#define STATS_BUFFER_SIZE   16384
+
+static volatile uint32_t* regs; // Fake GPI registers
+static uint32_t pin = 4; // GPI toggled by injector
+static uint32_t rate = 100; // Edges per second
+static uint64_t edgeTimes[EDGE_RING_SIZE]; // Injection time of each edge indexed by sequence
+static uint32_t edgeSeq = 0; // Quantity of edges injected
+static uint32_t seenSeq = 0; // Sequence of last detected edge
+static uint32_t latencies[LATENCY_BUCKETS]; // Histogram of detection latency in microseconds
+static uint32_t detected = 0; // Quantity of edges detected
+static uint32_t missed = 0; // Quantity of edges not detected
+static uint32_t maxLatency = 0; // Largest detection latency in microseconds
+static volatile uint8_t running = 1; // Cleared to stop injector and load threads
+
+// Called by poll thread when GPI value changes
+void onChange(uint32_t gpi, uint8_t value) {
+    if(gpi != pin)
+        return;
+    uint64_t now = getCounterNs();
+    uint32_t seq = __atomic_load_n(&edgeSeq, __ATOMIC_ACQUIRE);
+    if((seq & 1) != value)
+        --seq; // Another edge was injected after the sample was taken
+    if(seq == seenSeq)
+        return;
+    __atomic_fetch_add(&missed, seq - seenSeq - 1, __ATOMIC_RELAXED);
+    seenSeq = seq;
+    uint32_t latency = (now - edgeTimes[seq & (EDGE_RING_SIZE - 1)]) / 1000;
+    __atomic_fetch_add(&latencies[latency < LATENCY_BUCKETS ? latency : LATENCY_BUCKETS - 1], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&detected, 1, __ATOMIC_RELAXED);
+    if(latency > __atomic_load_n(&maxLatency, __ATOMIC_RELAXED))
+        __atomic_store_n(&maxLatency, latency, __ATOMIC_RELAXED);
+}
+
+// Thread toggling GPI level at randomised intervals
+void* inject(void* arg) {
+    unsigned int seed = 1;
+    uint64_t interval = 1000000000ULL / rate;
+    uint64_t next = getTimeNs(); // Same timebase as clock_nanosleep
+    while(running) {
+        next += interval / 2 + (uint64_t)rand_r(&seed) % (interval + 1); // Uniform 0.5..1.5 x interval
+        struct timespec ts = {next / 1000000000, next % 1000000000};
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+        uint32_t seq = edgeSeq + 1;
+        edgeTimes[seq & (EDGE_RING_SIZE - 1)] = getCounterNs();
+        __atomic_store_n(&edgeSeq, seq, __ATOMIC_RELEASE);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST); // Sequence must be visible before level changes
+        regs[BCM2835_GPLEV0] ^= 1 << pin;
+    }
+    return NULL;
+}
+
+// Thread applying synthetic CPU load
+void* load(void* arg) {
+    volatile uint32_t sink = 0;
+    while(running)
+        for(uint32_t i = 0; i < 100000; ++i)
+            sink += i * i;
+    return NULL;
+}
+
+// Get latency (us) below which the requested fraction of detected edges fall
+uint32_t getPercentile(double fraction) {
+    uint32_t total = __atomic_load_n(&detected, __ATOMIC_RELAXED);
+    uint64_t target = total * fraction;
+    uint64_t count = 0;
+    for(uint32_t us = 0; us < LATENCY_BUCKETS; ++us) {
+        count += __atomic_load_n(&latencies[us], __ATOMIC_RELAXED);
+        if(count > target)
+            return us;
+    }
+    return LATENCY_BUCKETS;
+}
+
+void report(uint32_t elapsed) {
+    printf("%6us injected=%u detected=%u missed=%u p50=%uus p99=%uus max=%uus\n", elapsed,
+        __atomic_load_n(&edgeSeq, __ATOMIC_RELAXED), __atomic_load_n(&detected, __ATOMIC_RELAXED),
+        __atomic_load_n(&missed, __ATOMIC_RELAXED), getPercentile(0.5), getPercentile(0.99),
+        __atomic_load_n(&maxLatency, __ATOMIC_RELAXED));
+    fflush(stdout);
+}
+
+int main(int argc, char* argv[]) {
+    uint32_t duration = 10, loadThreads = 0, interval = 1;
+    uint32_t period = POLL_SLEEP_US;
+    int policy = SCHED_OTHER, priority = 0, opt;
+    while((opt = getopt(argc, argv, "d:p:r:l:s:P:g:i:h")) != -1) {
+        switch(opt) {
+            case 'd': duration = atoi(optarg); break;
+            case 'p': period = atoi(optarg); break;
+            case 'r': rate = atoi(optarg); break;
+            case 'l': loadThreads = atoi(optarg); break;
+            case 's': policy = strcmp(optarg, "fifo") == 0 ? SCHED_FIFO : strcmp(optarg, "rr") == 0 ? SCHED_RR : SCHED_OTHER; break;
+            case 'P': priority = atoi(optarg); break;
+            case 'g': pin = atoi(optarg); break;
+            case 'i': interval = atoi(optarg); break;
+            default:
+                printf("Usage: %s [-d seconds] [-p poll_us] [-r edges_per_second] [-l load_threads] [-s other|fifo|rr] [-P priority] [-g gpi] [-i report_seconds]\n", argv[0]);
+                return opt == 'h' ? 0 : -1;
+        }
+    }
+    if(!rate || !interval || pin < 2 || pin > 27) {
+        fprintf(stderr, "Invalid parameters\n");
+        return -1;
+    }
+
+    char path[FAKE_GPIMEM_PATH_LEN];
+    if(createFakeGpiMem(path, &regs) < 0) {
+        fprintf(stderr, "Failed to create fake GPI register file\n");
+        return -1;
+    }
+    setPollPeriod(period);
+    int err = setPollScheduling(policy, priority);
+    if(err)
+        fprintf(stderr, "Failed to set poll thread scheduling: %s\n", strerror(err));
+    setGpiChangeCallback(onChange);
+    setRpiGpiMemDevice(path);
+    if(addRpiGpiDevice() < 0) {
+        fprintf(stderr, "Failed to add RPi GPI driver\n");
+        return -1;
+    }
+    enableGpi(pin, 1);
+
+    printf("Soak: %us, poll period %uus, %u edges/s on GPI %u, %u load threads, policy %d priority %d\n",
+        duration, getPollPeriod(), rate, pin, loadThreads, policy, priority);
+    pthread_t injector, loaders[loadThreads ? loadThreads : 1];
+    for(uint32_t i = 0; i < loadThreads; ++i)
+        pthread_create(&loaders[i], NULL, load, NULL);
+    pthread_create(&injector, NULL, inject, NULL);
+    resetStats();
+    for(uint32_t elapsed = interval; elapsed <= duration; elapsed += interval) {
+        sleep(interval);
+        report(elapsed);
+    }
+    running = 0;
+    pthread_join(injector, NULL);
+    for(uint32_t i = 0; i < loadThreads; ++i)
+        pthread_join(loaders[i], NULL);
+    shutdownGpi();
+
+    char buffer[STATS_BUFFER_SIZE];
+    dumpStats(buffer, sizeof(buffer));
+    printf("\n%s", buffer);
+    return 0;
+}
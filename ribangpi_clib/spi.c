@@ -0,0 +1,95 @@
+/*
+ * ******************************************************************
+ * ZYNTHIAN PROJECT: SPI Library
+ *
+ * Library for interfacing SPI with Zynthian
+ *
+ * Copyright (C) 2021 Brian Walton <riban@zynthian.org>
+ *
+ * ******************************************************************
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * For a full copy of the GNU General Public License see the LICENSE.txt file.
+ *
+ * ******************************************************************
+ */
+
+#include "spi.h"
+#include <stdio.h> // Provides snprintf
+
+static uint32_t spiSpeed = SPI_DEFAULT_SPEED_HZ; // Clock speed used when opening chip selects
+static int spiFds[SPI_MAX_CS] = {-1, -1}; // Handle of each open chip select
+
+int spiDevOpen(uint8_t cs, uint32_t speed) {
+    char path[20];
+    snprintf(path, sizeof(path), "/dev/spidev0.%u", cs);
+    int fd = open(path, O_RDWR);
+    if(fd < 0)
+        return fd;
+    uint8_t mode = SPI_MODE_0;
+    uint8_t bits = 8;
+    if(ioctl(fd, SPI_IOC_WR_MODE, &mode) < 0 || ioctl(fd, SPI_IOC_WR_BITS_PER_WORD, &bits) < 0 || ioctl(fd, SPI_IOC_WR_MAX_SPEED_HZ, &speed) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+void spiDevClose(int fd) {
+    close(fd);
+}
+
+int spiDevTransfer(int fd, struct spi_ioc_transfer* xfers, uint8_t count) {
+    return ioctl(fd, SPI_IOC_MESSAGE(count), xfers) < 0 ? -1 : 0;
+}
+
+const spi_transport_t spiDevTransport = {spiDevOpen, spiDevClose, spiDevTransfer};
+static const spi_transport_t* spiTransport = &spiDevTransport; // Currently selected transport
+
+void spiSetTransport(const spi_transport_t* transport) {
+    spiClose();
+    spiTransport = transport ? transport : &spiDevTransport;
+}
+
+void spiSetSpeed(uint32_t hz) {
+    if(hz)
+        spiSpeed = hz;
+}
+
+int spiOpen(uint8_t cs) {
+    if(cs >= SPI_MAX_CS)
+        return -1;
+    if(spiFds[cs] < 0)
+        spiFds[cs] = spiTransport->open(cs, spiSpeed);
+    return spiFds[cs];
+}
+
+void spiClose() {
+    for(uint8_t cs = 0; cs < SPI_MAX_CS; ++cs) {
+        if(spiFds[cs] < 0)
+            continue;
+        spiTransport->close(spiFds[cs]);
+        spiFds[cs] = -1;
+    }
+}
+
+int spiTransfer(uint8_t cs, const uint8_t* tx, uint8_t* rx, uint32_t len) {
+    if(cs >= SPI_MAX_CS || spiFds[cs] < 0)
+        return -1;
+    struct spi_ioc_transfer xfer = {0};
+    xfer.tx_buf = (uintptr_t)tx;
+    xfer.rx_buf = (uintptr_t)rx;
+    xfer.len = len;
+    xfer.speed_hz = spiSpeed;
+    xfer.bits_per_word = 8;
+    return spiTransport->transfer(spiFds[cs], &xfer, 1);
+}
@@ -0,0 +1,75 @@
+/*
+ * ******************************************************************
+ * ZYNTHIAN PROJECT: SPI Library
+ *
+ * Library for interfacing SPI with Zynthian
+ *
+ * Copyright (C) 2021 Brian Walton <riban@zynthian.org>
+ *
+ * ******************************************************************
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * For a full copy of the GNU General Public License see the LICENSE.txt file.
+ *
+ * ******************************************************************
+ */
+#ifndef ZYNSPI_H_INCLUDED
+#define ZYNSPI_H_INCLUDED
+
+#include <stdint.h> //Provides fixed width integer definitions
+#include <sys/ioctl.h> //Provides device driver i/o control
+#include <linux/spi/spidev.h> //Provides userspace spi interface
+#include <fcntl.h> //Provides file open
+#include <unistd.h> //Provides file close
+
+#define SPI_MAX_CS              2 // Quantity of chip selects on bus (spidev0.0, spidev0.1)
+#define SPI_DEFAULT_SPEED_HZ    10000000 // Default clock: 10MHz, maximum of MCP23S17
+
+//  Structure describing a pluggable SPI transport, e.g. Linux spidev or simulator
+typedef struct spi_transport_t {
+    int(*open)(uint8_t cs, uint32_t speed); // Open chip select, returning non-negative handle or negative error
+    void(*close)(int fd);   // Close chip select
+    int(*transfer)(int fd, struct spi_ioc_transfer* xfers, uint8_t count); // Perform transfers with chip select asserted, returning 0 on success or negative error
+} spi_transport_t;
+
+/** @brief  Select SPI transport
+*   @param  transport Pointer to transport or NULL for Linux spidev "/dev/spidev0.<cs>"
+*   @note   Closes currently open chip selects. Transport structure must remain valid whilst selected.
+*/
+void spiSetTransport(const spi_transport_t* transport);
+
+/** @brief  Set SPI clock speed used when opening chip selects
+*   @param  hz Clock frequency in Hz
+*   @note   Applies to chip selects opened after call
+*/
+void spiSetSpeed(uint32_t hz);
+
+/** @brief  Open SPI chip select, by default "/dev/spidev0.<cs>" in mode 0 with 8 bit words
+*   @param  cs Chip select [0..SPI_MAX_CS-1]
+*   @retval int File descriptor or negative error
+*/
+int spiOpen(uint8_t cs);
+
+/** @brief  Close all open SPI chip selects
+*/
+void spiClose();
+
+/** @brief  Perform a single full-duplex transfer
+*   @param  cs Chip select
+*   @param  tx Pointer to bytes to send
+*   @param  rx Pointer to buffer to populate with received bytes or NULL to discard
+*   @param  len Quantity of bytes to transfer
+*   @retval int 0 on success or negative error
+*/
+int spiTransfer(uint8_t cs, const uint8_t* tx, uint8_t* rx, uint32_t len);
+
+#endif // ZYNSPI_H_INCLUDED
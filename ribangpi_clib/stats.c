@@ -0,0 +1,154 @@
+/*
+ * ******************************************************************
+ * ZYNTHIAN PROJECT: GPI Library
+ *
+ * Instrumentation of GPI polling and bus access
+ *
+ * Copyright (C) 2021 Brian Walton <riban@zynthian.org>
+ *
+ * ******************************************************************
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * For a full copy of the GNU General Public License see the LICENSE.txt file.
+ *
+ * ******************************************************************
+ */
+
+#include "stats.h"
+#include <string.h> // Provides memset
+
+#define statsAdd(counter, value) __atomic_fetch_add(&(counter), (value), __ATOMIC_RELAXED)
+#define statsLoad(counter) __atomic_load_n(&(counter), __ATOMIC_RELAXED)
+#define statsStore(counter, value) __atomic_store_n(&(counter), (value), __ATOMIC_RELAXED)
+
+// Position and remaining size in dump buffer, clamped so that truncated output is still null terminated
+#define DUMP_POS buffer + (len < size ? len : size), len < size ? size - len : 0
+
+static gpi_stats_t stats; // Live counters - only accessed via atomic operations
+
+/*  Define private functions */
+void recordHistogram(gpi_histogram_t* histogram, uint32_t us) {
+    uint8_t bucket = us ? 32 - __builtin_clz(us) : 0;
+    if(bucket >= STATS_HISTOGRAM_BUCKETS)
+        bucket = STATS_HISTOGRAM_BUCKETS - 1;
+    statsAdd(histogram->count, 1);
+    statsAdd(histogram->total, us);
+    statsAdd(histogram->buckets[bucket], 1);
+    uint32_t max = statsLoad(histogram->max);
+    while(us > max && !__atomic_compare_exchange_n(&histogram->max, &max, us, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        ; // max is updated by failed exchange
+}
+
+void copyCounters(uint32_t* dest, uint32_t* src, uint32_t count) {
+    for(uint32_t i = 0; i < count; ++i)
+        dest[i] = statsLoad(src[i]);
+}
+
+uint32_t dumpHistogram(char* buffer, uint32_t size, const char* name, gpi_histogram_t* histogram) {
+    uint32_t len = snprintf(buffer, size, "%s: count=%u mean=%uus max=%uus\n", name, histogram->count,
+        histogram->count ? histogram->total / histogram->count : 0, histogram->max);
+    for(uint8_t bucket = 0; bucket < STATS_HISTOGRAM_BUCKETS; ++bucket) {
+        if(!histogram->buckets[bucket])
+            continue;
+        if(bucket == STATS_HISTOGRAM_BUCKETS - 1)
+            len += snprintf(DUMP_POS, "\t>=%uus: %u\n", 1 << (bucket - 1), histogram->buckets[bucket]);
+        else
+            len += snprintf(DUMP_POS, "\t<%uus: %u\n", 1 << bucket, histogram->buckets[bucket]);
+    }
+    return len;
+}
+
+void getStats(gpi_stats_t* snapshot) {
+    if(!snapshot)
+        return;
+    copyCounters((uint32_t*)snapshot, (uint32_t*)&stats, sizeof(gpi_stats_t) / sizeof(uint32_t));
+}
+
+void resetStats() {
+    uint32_t* counters = (uint32_t*)&stats;
+    for(uint32_t i = 0; i < sizeof(gpi_stats_t) / sizeof(uint32_t); ++i)
+        statsStore(counters[i], 0);
+}
+
+uint32_t dumpStats(char* buffer, uint32_t size) {
+    gpi_stats_t snapshot;
+    char name[32];
+    getStats(&snapshot);
+    if(!buffer)
+        size = 0;
+    uint32_t len = snprintf(buffer, size, "Poll cycles: %u\n", snapshot.pollCycles);
+    len += dumpHistogram(DUMP_POS, "Poll jitter", &snapshot.pollJitter);
+    for(uint8_t driver = 0; driver < MAX_GPI_DRIVERS; ++driver) {
+        if(!snapshot.pollDuration[driver].count)
+            continue;
+        snprintf(name, sizeof(name), "Driver %u poll", driver);
+        len += dumpHistogram(DUMP_POS, name, &snapshot.pollDuration[driver]);
+    }
+    for(uint8_t address = 0; address < STATS_I2C_ADDRESSES; ++address) {
+        i2c_stats_t* i2c = &snapshot.i2c[address];
+        if(i2c->transactions)
+            len += snprintf(DUMP_POS, "I2C 0x%02x: transactions=%u bytes=%u errors=%u\n",
+                address, i2c->transactions, i2c->bytes, i2c->errors);
+    }
+    if(snapshot.eventHighWater)
+        len += snprintf(DUMP_POS, "Event queue: high water=%u overflow=%u coalesced=%u\n", snapshot.eventHighWater,
+            snapshot.eventOverflow, snapshot.eventCoalesced);
+    if(snapshot.midiBytes || snapshot.midiDropped)
+        len += snprintf(DUMP_POS, "MIDI: bytes=%u dropped=%u\n", snapshot.midiBytes, snapshot.midiDropped);
+    for(uint32_t gpi = 0; gpi < MAX_GPI; ++gpi) {
+        if(snapshot.events[gpi])
+            len += snprintf(DUMP_POS, "GPI %u: events=%u\n", gpi, snapshot.events[gpi]);
+    }
+    return len;
+}
+
+void statsRecordPoll(uint8_t driver, uint32_t us) {
+    if(driver < MAX_GPI_DRIVERS)
+        recordHistogram(&stats.pollDuration[driver], us);
+}
+
+void statsRecordJitter(uint32_t us) {
+    statsAdd(stats.pollCycles, 1);
+    recordHistogram(&stats.pollJitter, us);
+}
+
+void statsRecordI2c(uint8_t address, uint32_t bytes, uint8_t error) {
+    if(address >= STATS_I2C_ADDRESSES)
+        return;
+    statsAdd(stats.i2c[address].transactions, 1);
+    statsAdd(stats.i2c[address].bytes, bytes);
+    if(error)
+        statsAdd(stats.i2c[address].errors, 1);
+}
+
+void statsRecordEvent(uint32_t gpi) {
+    if(gpi < MAX_GPI)
+        statsAdd(stats.events[gpi], 1);
+}
+
+void statsRecordEventQueue(uint32_t depth, uint8_t overflow) {
+    if(overflow)
+        statsAdd(stats.eventOverflow, 1);
+    uint32_t max = statsLoad(stats.eventHighWater);
+    while(depth > max && !__atomic_compare_exchange_n(&stats.eventHighWater, &max, depth, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        ;
+}
+
+void statsRecordEventCoalesced() {
+    statsAdd(stats.eventCoalesced, 1);
+}
+
+void statsRecordMidi(uint32_t bytes, uint32_t dropped) {
+    statsAdd(stats.midiBytes, bytes);
+    if(dropped)
+        statsAdd(stats.midiDropped, dropped);
+}
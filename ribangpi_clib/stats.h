@@ -0,0 +1,124 @@
+/*
+ * ******************************************************************
+ * ZYNTHIAN PROJECT: GPI Library
+ *
+ * Instrumentation of GPI polling and bus access
+ *
+ * Copyright (C) 2021 Brian Walton <riban@zynthian.org>
+ *
+ * ******************************************************************
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * For a full copy of the GNU General Public License see the LICENSE.txt file.
+ *
+ * ******************************************************************
+ */
+#ifndef ZYNGPISTATS_H_INCLUDED
+#define ZYNGPISTATS_H_INCLUDED
+
+#include "gpi.h"
+
+#define STATS_HISTOGRAM_BUCKETS 16 // Bucket n holds samples < 2^n us, last bucket holds all larger samples
+#define STATS_I2C_ADDRESSES     128 // Quantity of 7-bit I2C addresses
+
+/*  All counters are 32-bit, updated with relaxed atomic operations and wrap on overflow.
+    Counters accumulate from library load or last call to resetStats().
+*/
+
+//  Structure describing a histogram of durations
+typedef struct gpi_histogram_t {
+    uint32_t count;         // Quantity of samples
+    uint32_t total;         // Sum of all samples in microseconds
+    uint32_t max;           // Largest sample in microseconds
+    uint32_t buckets[STATS_HISTOGRAM_BUCKETS]; // Quantity of samples in each log2 microsecond bucket
+} gpi_histogram_t;
+
+//  Structure describing I2C bus usage for a remote device
+typedef struct i2c_stats_t {
+    uint32_t transactions;  // Quantity of read / write transactions
+    uint32_t bytes;         // Quantity of bytes transferred
+    uint32_t errors;        // Quantity of failed transactions
+} i2c_stats_t;
+
+//  Structure holding all instrumentation
+typedef struct gpi_stats_t {
+    uint32_t pollCycles;                            // Quantity of poll thread cycles
+    gpi_histogram_t pollDuration[MAX_GPI_DRIVERS];  // Time taken by each driver's poll function, indexed by driver
+    gpi_histogram_t pollJitter;                     // Difference between requested and actual poll thread sleep
+    i2c_stats_t i2c[STATS_I2C_ADDRESSES];           // I2C usage indexed by device address
+    uint32_t events[MAX_GPI];                       // Quantity of changes of value detected, indexed by GPI
+    uint32_t eventOverflow;                         // Quantity of events discarded because event queue was full
+    uint32_t eventHighWater;                        // Largest quantity of events waiting in event queue
+    uint32_t eventCoalesced;                        // Quantity of events merged into a queued or held event by delivery policy
+    uint32_t midiBytes;                             // Quantity of bytes written by MIDI bridge
+    uint32_t midiDropped;                           // Quantity of bytes MIDI bridge failed to write, e.g. output full
+} gpi_stats_t;
+
+/** @brief  Get a snapshot of instrumentation
+*   @param  stats Pointer to structure to populate
+*   @note   Each counter is read atomically but the snapshot as a whole is not
+*/
+void getStats(gpi_stats_t* stats);
+
+/** @brief  Reset all instrumentation counters to zero
+*/
+void resetStats();
+
+/** @brief  Write human readable summary of instrumentation to a buffer
+*   @param  buffer Pointer to buffer to populate with null terminated text
+*   @param  size Size of buffer in bytes
+*   @retval uint32_t Quantity of characters that would be written if buffer was large enough (excluding null terminator)
+*   @note   Only non-zero entries are listed
+*/
+uint32_t dumpStats(char* buffer, uint32_t size);
+
+/** @brief  Record duration of a driver's poll function
+*   @param  driver Index of driver
+*   @param  us Duration in microseconds
+*/
+void statsRecordPoll(uint8_t driver, uint32_t us);
+
+/** @brief  Record difference between requested and actual poll thread sleep
+*   @param  us Absolute difference in microseconds
+*/
+void statsRecordJitter(uint32_t us);
+
+/** @brief  Record an I2C transaction
+*   @param  address I2C address of remote device
+*   @param  bytes Quantity of bytes transferred
+*   @param  error 1 if transaction failed
+*/
+void statsRecordI2c(uint8_t address, uint32_t bytes, uint8_t error);
+
+/** @brief  Record a change of GPI value
+*   @param  gpi Index of GPI within global gpimap
+*/
+void statsRecordEvent(uint32_t gpi);
+
+/** @brief  Record depth of event queue after an event is queued
+*   @param  depth Quantity of events waiting in queue
+*   @param  overflow 1 if an event was discarded to make space
+*/
+void statsRecordEventQueue(uint32_t depth, uint8_t overflow);
+
+/** @brief  Record an event merged into a queued or held event by delivery policy
+*/
+void statsRecordEventCoalesced();
+
+/** @brief  Record a write by MIDI bridge
+*   @param  bytes Quantity of bytes written
+*   @param  dropped Quantity of bytes that could not be written
+*/
+void statsRecordMidi(uint32_t bytes, uint32_t dropped);
+
+//-----------------------------------------------------------------------------
+#endif // ZYNGPISTATS_H_INCLUDED
@@ -0,0 +1,121 @@
+/*
+ * ******************************************************************
+ * ZYNTHIAN PROJECT: GPI Library
+ *
+ * Low overhead timestamp sources
+ *
+ * Copyright (C) 2021 Brian Walton <riban@zynthian.org>
+ *
+ * ******************************************************************
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * For a full copy of the GNU General Public License see the LICENSE.txt file.
+ *
+ * ******************************************************************
+ */
+
+#include "timing.h"
+#include <pthread.h> // Provides pthread_once
+
+#define TSC_CALIBRATION_NS  10000000 // Duration to measure TSC frequency
+
+/*  Counter scaling, written once during calibration then read only
+    ns = baseNs + ((ticks - baseTicks) * mult) >> shift
+*/
+static uint64_t baseTicks = 0; // Counter value at calibration
+static uint64_t baseNs = 0; // CLOCK_MONOTONIC at calibration
+static uint32_t mult = 0; // Scale factor, 0 if no counter available
+static uint32_t shift = 0; // Scale shift
+static pthread_once_t counterOnce = PTHREAD_ONCE_INIT;
+
+/*  Define private functions */
+static inline uint64_t readCounter() {
+#if defined(__aarch64__)
+    uint64_t ticks;
+    __asm__ volatile("isb; mrs %0, cntvct_el0" : "=r" (ticks) :: "memory");
+    return ticks;
+#elif defined(__arm__) && defined(__ARM_ARCH_7A__)
+    uint64_t ticks;
+    __asm__ volatile("isb; mrrc p15, 1, %Q0, %R0, c14" : "=r" (ticks) :: "memory");
+    return ticks;
+#elif defined(__x86_64__) || defined(__i386__)
+    uint32_t lo, hi;
+    __asm__ volatile("rdtsc" : "=a" (lo), "=d" (hi));
+    return ((uint64_t)hi << 32) | lo;
+#else
+    return 0;
+#endif
+}
+
+static uint64_t getCounterFrequency() {
+#if defined(__aarch64__)
+    uint64_t freq;
+    __asm__ volatile("mrs %0, cntfrq_el0" : "=r" (freq));
+    return freq;
+#elif defined(__arm__) && defined(__ARM_ARCH_7A__)
+    uint32_t freq;
+    __asm__ volatile("mrc p15, 0, %0, c14, c0, 0" : "=r" (freq));
+    return freq;
+#elif defined(__x86_64__) || defined(__i386__)
+    uint64_t startNs = getTimeNs();
+    uint64_t startTicks = readCounter();
+    while(getTimeNs() - startNs < TSC_CALIBRATION_NS)
+        ;
+    uint64_t ns = getTimeNs() - startNs;
+    uint64_t ticks = readCounter() - startTicks;
+    return ticks * 1000000000ULL / ns;
+#else
+    return 0;
+#endif
+}
+
+static void calibrateCounter() {
+    uint64_t freq = getCounterFrequency();
+    if(!freq)
+        return;
+    // Largest shift that keeps mult within 32 bits for best precision
+    for(shift = 32; shift > 0; --shift) {
+        uint64_t m = (1000000000ULL << shift) / freq;
+        if(m <= 0xFFFFFFFF) {
+            mult = m;
+            break;
+        }
+    }
+    baseNs = getTimeNs();
+    baseTicks = readCounter();
+}
+
+uint64_t getCounterNs() {
+    pthread_once(&counterOnce, calibrateCounter);
+    if(!mult)
+        return getTimeNs();
+    uint64_t delta = readCounter() - baseTicks;
+    // Split multiply avoids 128-bit arithmetic: each partial product fits within 64 bits
+    return baseNs + (((delta >> 32) * mult) << (32 - shift)) + (((delta & 0xFFFFFFFF) * mult) >> shift);
+}
+
+void spinDelayUs(uint32_t us) {
+    uint64_t end = getCounterNs() + us * 1000ULL;
+    while(getCounterNs() < end)
+        ;
+}
+
+const char* getCounterName() {
+    pthread_once(&counterOnce, calibrateCounter);
+    if(!mult)
+        return "clock_gettime";
+#if defined(__x86_64__) || defined(__i386__)
+    return "tsc";
+#else
+    return "cntvct";
+#endif
+}
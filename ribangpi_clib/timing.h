@@ -0,0 +1,103 @@
+/*
+ * ******************************************************************
+ * ZYNTHIAN PROJECT: GPI Library
+ *
+ * Low overhead timestamp sources
+ *
+ * Copyright (C) 2021 Brian Walton <riban@zynthian.org>
+ *
+ * ******************************************************************
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * For a full copy of the GNU General Public License see the LICENSE.txt file.
+ *
+ * ******************************************************************
+ */
+
+/*  All sources are monotonic and thread safe with no shared mutable state.
+    getTime* use CLOCK_MONOTONIC which is vDSO accelerated (no syscall) on Raspberry Pi kernels, unlike CLOCK_MONOTONIC_RAW.
+    getCoarseTime* use CLOCK_MONOTONIC_COARSE which is cheaper still but only advances each scheduler tick (1-10ms).
+    getCounterNs reads the CPU counter directly (ARM generic timer cntvct or x86 TSC) and scales it to nanoseconds with a
+    multiply and shift. It is anchored to CLOCK_MONOTONIC at first use so may be compared with getTimeNs, allowing for slow drift.
+    Architectures without a supported counter fall back to getTimeNs.
+*/
+
+#ifndef ZYNTIMING_H_INCLUDED
+#define ZYNTIMING_H_INCLUDED
+
+#include <stdint.h> // Provides fixed width integer types
+#include <time.h> // Provides clock_gettime
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief  Get monotonic time in nanoseconds
+*   @retval uint64_t Nanoseconds since arbitrary epoch (typically boot)
+*/
+static inline uint64_t getTimeNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/** @brief  Get monotonic time in microseconds
+*   @retval uint64_t Microseconds since arbitrary epoch (typically boot)
+*/
+static inline uint64_t getTimeUs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/** @brief  Get monotonic time in milliseconds
+*   @retval uint64_t Milliseconds since arbitrary epoch (typically boot)
+*/
+static inline uint64_t getTimeMs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/** @brief  Get coarse monotonic time in milliseconds
+*   @retval uint64_t Milliseconds since arbitrary epoch, resolution of scheduler tick
+*/
+static inline uint64_t getCoarseTimeMs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/** @brief  Get time from CPU counter in nanoseconds
+*   @retval uint64_t Nanoseconds on CLOCK_MONOTONIC timebase
+*   @note   First call calibrates counter (up to 10ms on x86), call during initialisation to avoid delay on hot path
+*/
+uint64_t getCounterNs();
+
+/** @brief  Get name of counter used by getCounterNs
+*   @retval const char* Counter name ["cntvct" | "tsc" | "clock_gettime"]
+*/
+const char* getCounterName();
+
+/** @brief  Busy wait for at least a quantity of microseconds without sleeping
+*   @param  us Quantity of microseconds
+*   @note   For short register setup delays - usleep(1) sleeps tens of microseconds. Spins until a deadline on the CPU counter
+*           so delay is not shortened by CPU frequency changes.
+*/
+void spinDelayUs(uint32_t us);
+
+#ifdef __cplusplus
+}
+#endif
+
+//-----------------------------------------------------------------------------
+#endif // ZYNTIMING_H_INCLUDED